@@ -0,0 +1,35 @@
+#!/bin/sh
+# Simulator throughput as the core count grows.
+# Generates synthetic traces (mostly-private streams plus a shared region) for
+# each core count and reports host throughput from L1simulate --perf.
+#
+# Usage: bench/core_scaling.sh [refs_per_core] [extra L1simulate options]
+# Run from the project root after `make`.
+
+REFS=${1:-100000}
+[ $# -gt 0 ] && shift
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+printf "%6s %12s %14s %16s\n" "cores" "sim_ms" "refs/s" "bus_transactions"
+for CORES in 4 8 16 32 64; do
+    i=0
+    while [ $i -lt "$CORES" ]; do
+        awk -v n="$REFS" -v core="$i" 'BEGIN {
+            srand(core + 1)
+            for (k = 0; k < n; k++) {
+                if (rand() < 0.2) addr = int(rand() * 4096) * 4                 # shared region
+                else addr = core * 1048576 + int(rand() * 65536) * 4          # private region
+                printf "%s 0x%x\n", (rand() < 0.3 ? "W" : "R"), addr
+            }
+        }' > "$DIR/scale_proc$i.trace"
+        i=$((i + 1))
+    done
+
+    OUT=$(./L1simulate -t "$DIR/scale" -n "$CORES" --perf "$@")
+    SIM_MS=$(echo "$OUT" | sed -n 's/^Simulation Time (ms): //p')
+    RATE=$(echo "$OUT" | sed -n 's/^Simulation Throughput (refs\/s): //p')
+    BUS=$(echo "$OUT" | sed -n 's/^Total Bus Transactions: //p')
+    printf "%6s %12s %14s %16s\n" "$CORES" "$SIM_MS" "$RATE" "$BUS"
+    rm -f "$DIR"/scale_proc*.trace
+done
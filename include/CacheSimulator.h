@@ -1,11 +1,18 @@
 #pragma once
 #include <vector>
+#include <algorithm>
 #include <fstream>
 #include <queue>
 #include <optional>
+#include <memory>
 #include <cstdint>
 #include <string>
 #include "L1Cache.h"
+#include "TraceStream.h"
+#include "SnoopFilter.h"
+#include "L2Cache.h"
+#include "SharingProfiler.h"
+#include "LatencyHistogram.h"
 
 // Statistics for bus activity
 struct BusStats
@@ -13,42 +20,281 @@ struct BusStats
     int invalidations = 0;
     long long data_traffic_bytes = 0;
     int transactions = 0; // Count of bus transactions
+    long long prefetch_traffic_bytes = 0; // Part of data_traffic_bytes moved by prefetches
+    long long l2_traffic_bytes = 0;       // Blocks moved between the L1s and the L2
+    long long memory_traffic_bytes = 0;   // Blocks moved between the L2 and memory
+};
+
+// Per-core bus request latency distributions, by request category. End-to-end
+// latency belongs to the access, not the request, so each L1 keeps its own.
+struct LatencyStats
+{
+    // Prefetches get their own row; latencyCategory maps requests onto these
+    enum Category { BUS_RD, BUS_RDX, BUS_UPGR, FLUSH, FLUSH_OPT, EVICT_CLEAN, PREFETCH, CATEGORIES };
+    LatencyHistogram queue_wait[CATEGORIES]; // Queued until granted the bus
+    LatencyHistogram service[CATEGORIES];    // Granted until complete
+};
+
+// One period of a sampled run: a functionally warmed stretch, then a detailed
+// warm-up and a measured window
+struct SamplePeriod
+{
+    long long functional_refs = 0; // Over all cores
+    long long window_refs = 0;     // Measured, over all cores
+    long long window_cycles = 0;
+    // Per core
+    std::vector<long long> active_refs;     // Functional references warmed while the core still had references
+    std::vector<long long> detailed_cycles; // Execution and idle cycles in the warm-up and window
+    std::vector<long long> refs;            // Measured references
+    std::vector<long long> misses;          // Misses among them
 };
 
 struct BusRequestComparator
 {
-    // Comparator for arbitration: lower core_id has higher priority
+    // Comparator for arbitration: demand requests before prefetches, then lower
+    // core_id has higher priority
     bool operator()(const BusRequest &a, const BusRequest &b) const
     {
+        bool a_low = a.is_prefetch && !a.promoted;
+        bool b_low = b.is_prefetch && !b.promoted;
+        if (a_low != b_low)
+            return a_low;
         return a.core_id > b.core_id;
     }
 };
 
+// Arbitration queue. The heap is exposed so a checkpoint can restore it exactly,
+// keeping the order between requests that compare equal.
+class BusQueue : public std::priority_queue<BusRequest, std::vector<BusRequest>, BusRequestComparator>
+{
+public:
+    std::vector<BusRequest> &heap() { return c; }
+    const std::vector<BusRequest> &heap() const { return c; }
+
+    // Remove the request at heap index i, which need not be the top
+    BusRequest take(size_t i)
+    {
+        BusRequest br = c[i];
+        if (i == 0)
+        {
+            pop();
+            return br;
+        }
+        c[i] = c.back();
+        c.pop_back();
+        std::make_heap(c.begin(), c.end(), comp);
+        return br;
+    }
+};
+
+// Per-core traces loaded once and shared read-only between simulators
+using SharedTraces = std::vector<std::shared_ptr<const std::vector<MemRef>>>;
+
+// Cycles for a memory read or writeback
+const int MEMORY_LATENCY = 100;
+
+// Upper bound on cores, set by the 64-bit presence masks of the snoop filter
+const int MAX_CORES = 64;
+
 class CacheSimulator
 {
 public:
-    CacheSimulator(int s, int E, int b);
+    CacheSimulator(int s, int E, int b, int cores = 4);
     ~CacheSimulator(); // Adding a proper destructor
+    void setDebug(bool enabled);             // Cycle-by-cycle logging of this instance
+    void setCycleSkipping(bool enabled);     // Jump over cycles where every core is stalled
+    void setSplitBus(int max_outstanding);   // Split-transaction bus (0 = atomic bus)
+    void setMshrs(int count);                // Non-blocking caches with `count` MSHRs (0 = blocking)
+    void setWriteBuffer(int depth);          // Per-core write buffers of `depth` entries (0 = none)
+    bool setReplacementPolicy(const std::string &name); // False for an unknown policy
+    bool setPrefetcher(const std::string &name, int degree); // False for an unknown prefetcher
+    bool setProtocol(const std::string &name); // False for an unknown coherence protocol
+    // Shared L2 between the bus and memory; false for an unknown replacement policy
+    bool enableL2(int s, int E, int b, int latency, const std::string &policy_name, InclusionPolicy policy);
+    // Sampled simulation: of every `period` references (over all cores), `warmup`
+    // run in detail to warm the bus and MSHRs, the next `window` are measured, and
+    // the rest only update cache and coherence state (0 simulates all in detail)
+    void setSampling(long long period, long long window, long long warmup);
+    // Functional mode: no timing; the cores take turns, each reference completing
+    // at once with its bus transactions applied inline
+    void setFunctional(bool enabled);
+    // Parallel engine: between bus events, the cores run on `threads` worker
+    // threads (0 keeps the serial engine). Results are identical either way.
+    void setParallel(int threads);
+    void setStreaming(size_t chunk_records); // Stream traces instead of loading them (0 = load)
+    void enableDataTracking();               // Give every cache line a data payload
+    void enableSnoopFilter();                // Only probe caches that hold the block
+    void enableSharingReport(int top);       // Report the `top` most contended blocks
+    void enableMissProfile(int region_bits); // Per-set, per-region and 3C miss counters
+    void enableLatencyStats();               // Per-core latency histograms by bus operation
+
+    // Number of consecutive <app_name>_procN.trace files starting from proc0
+    static int countTraceFiles(const std::string &app_name);
+    // Load the first `cores` trace files of app_name; bytes receives their total size
+    static bool readTraces(const std::string &app_name, int cores, SharedTraces &refs, size_t &bytes);
+    void attachTraces(const std::string &app_name, const SharedTraces &refs);
     bool loadTraces(const std::string &app_name);
+
+    // Write the complete simulation state to path once the run reaches at_cycle, or
+    // at_refs completed references over all cores (-1 disables either); the run
+    // then carries on to the end
+    void setCheckpoint(const std::string &path, long long at_cycle, long long at_refs);
+    // After configuring and loading traces: resume from a checkpoint taken with the
+    // same configuration. Sharing, miss and latency instrumentation starts empty.
+    bool restoreCheckpoint(const std::string &path);
+
     void runSimulation();
     void printResults(std::ofstream &outfile);
+    void printPerformance() const; // Host-side timing (trace load throughput)
+    double simulationSeconds() const { return simulation_seconds; }
+    // With miss profiling: <prefix>_sets.csv and <prefix>_regions.csv
+    bool writeMissProfile(const std::string &prefix) const;
+    // With latency statistics: every histogram as core,operation,metric,cycles,count rows
+    bool writeLatencyHistograms(const std::string &path) const;
+
+    // One CSV row per core, used to combine the results of a sweep
+    static void writeCsvHeader(std::ostream &out);
+    void writeCsvRows(std::ostream &out) const;
 
 private:
     std::string trace_prefix; // Store trace file prefix for display
-    int num_cores = 4;
+    int num_cores;
+    bool debug = false;
+    bool cycle_skipping = true;
     int s_bits;
     int E_assoc;
     int b_bits;
     std::vector<L1Cache> caches;
-    std::vector<std::vector<MemRef>> trace_data;
-    std::vector<size_t> trace_position;
+    std::vector<TraceStream> traces;
+    std::vector<int> compute_left; // Gap cycles each core still runs before its next reference
+    size_t stream_chunk_records = 0; // Records per streaming chunk, 0 loads traces fully
+    size_t trace_bytes = 0;          // Total size of the trace files
+    double trace_load_seconds = 0.0; // Wall-clock time spent in loadTraces
+    double simulation_seconds = 0.0; // Wall-clock time spent in runSimulation
     BusStats bus_stats;
     std::vector<BusStats> core_bus_stats; // Per-core bus statistics
+    std::unique_ptr<SnoopFilter> snoop_filter;
+    std::unique_ptr<SharingProfiler> sharing; // Null unless the sharing report is on
+    int sharing_top = 0;
+    std::vector<LatencyStats> latency; // Empty unless latency statistics are on
 
-    std::priority_queue<BusRequest, std::vector<BusRequest>, BusRequestComparator> bus_queue;
+    BusQueue bus_queue;
     bool bus_busy = false;
     int bus_free_cycle = 0;
     std::optional<BusRequest> current_bus;
     bool current_data_from_cache = false;
     MESIState current_new_state;
+    int total_cycles = 0;
+
+    // Split-transaction bus: memory accesses release the bus between their
+    // request and response phases, up to split_bus_slots of them at a time
+    enum class BusPhase
+    {
+        NONE,
+        ATOMIC,   // Upgrade or cache-to-cache transfer, holds the bus throughout
+        REQUEST,  // Address phase of a memory read, or data phase of a writeback
+        RESPONSE  // Data returning from memory
+    };
+    struct SplitTransaction
+    {
+        BusRequest request;
+        bool data_from_cache;
+        MESIState new_state;
+        int ready_cycle;        // Memory access finishes
+        bool awaiting_response; // Read still needs its response phase
+    };
+    int split_bus_slots = 0;
+    int mshrs_per_cache = 0;
+    int write_buffer_depth = 0;
+    std::string replacement_name = "LRU";
+    std::string prefetcher_name; // Empty without a prefetcher
+    int prefetch_degree = 0;
+    const ProtocolTable *protocol = findProtocol("mesi");
+    std::unique_ptr<L2Cache> l2; // Null without an L2
+    int l2_latency = 0;
+    InclusionPolicy inclusion = InclusionPolicy::INCLUSIVE;
+    std::vector<SplitTransaction> in_flight;
+    BusPhase current_phase = BusPhase::NONE;
+    int current_txn = -1; // Index into in_flight of the phase on the bus
+    int peak_in_flight = 0;
+    long long bus_busy_cycles = 0;
+
+    // Checkpointing
+    std::string checkpoint_path; // Empty unless a checkpoint is requested
+    long long checkpoint_cycle = -1;
+    long long checkpoint_refs = -1;
+    int resume_cycle = 0;             // Loop state restored from a checkpoint
+    std::vector<uint8_t> resume_done; // Empty unless restored
+    std::string checkpointConfig() const; // Everything the saved state depends on
+    bool saveCheckpoint(int cycle, const std::vector<bool> &done) const;
+
+    bool functional = false;
+    void runFunctional(int &cycle, std::vector<bool> &done, int &remaining);
+
+    // Sampling
+    long long sample_period = 0;
+    long long sample_window = 0;
+    long long sample_warmup = 0;
+    bool draining = false; // Cores hold back new references until the bus is quiet
+    std::vector<SamplePeriod> samples;
+    long long functional_refs = 0;
+    double functional_seconds = 0.0;
+    void runSampled(int &cycle, std::vector<bool> &done, int &remaining);
+    void functionalAccess(int core, int cycle); // Complete one reference with no timing
+    // Warm up to `count` references, spread over the cores by the last window's throughput
+    void warmFunctionally(long long count, int cycle, SamplePeriod &period);
+    bool quiescent() const;                     // No request queued, in flight or outstanding
+    void printSampling(std::ofstream &outfile) const;
+
+    // Parallel engine. Epochs run every core alone up to the next cycle at which
+    // the bus could touch a cache; the bus work the cores produce meanwhile is
+    // logged and replayed afterwards in serial order.
+    struct EpochEvent
+    {
+        int cycle;
+        int core;
+        std::vector<BusRequest> requests;
+        std::optional<uint32_t> late_prefetch; // Prefetch to promote after the requests
+    };
+    int parallel_threads = 0;
+    int parallel_workers = 0; // Threads used, at most one per core and per hardware thread
+    long long parallel_epochs = 0;
+    long long parallel_cycles = 0; // Cycles simulated inside epochs
+    void runParallel(int &cycle, std::vector<bool> &done, int &remaining);
+    int localHits(int core, int limit); // Accesses from the trace position that hit locally, up to limit
+
+    void setTracePrefix(const std::string &app_name);
+    // Snoop, pick the requester's new state, count stats and work out how long an
+    // atomic bus would be held
+    void beginTransaction(const BusRequest &br, int cycle, bool &data_from_cache,
+                          MESIState &new_state, int &duration);
+    void finishTransaction(const BusRequest &br, int cycle, bool data_from_cache, MESIState new_state);
+    void recordLatency(const BusRequest &br, int cycle); // The request completed at `cycle`
+    void printLatency() const;
+    // Serve a memory read or take a victim at the L2; returns the bus duration
+    int accessL2(const BusRequest &br, MESIState &new_state);
+    void insertL2(int core, uint32_t address, bool dirty);
+    void backInvalidate(uint32_t address); // Inclusive L2 evicted the block
+    long long countInclusionViolations() const; // L1 blocks an inclusive L2 does not hold
+    void stepAtomicBus(int cycle);
+    void stepSplitBus(int cycle);
+    int pickSplitRequest() const; // Heap index of the request to grant next, or -1
+    int responseCycles() const;
+    int nextBusEvent(int cycle) const;
+    void stepCores(int cycle, std::vector<bool> &done, int &remaining);
+    // One cycle of one core; false once it has finished. With a log, requests and
+    // prefetch promotions go there instead of onto the bus queue.
+    bool stepCore(int core, int cycle, std::vector<EpochEvent> *log);
+    void stepCycle(int &cycle, std::vector<bool> &done, int &remaining); // One cycle, or a skip past stalls
+    long long completedRefs() const; // References consumed over all cores
+    void advanceTrace(int core);     // Move past the current reference and take up the next one's gap
+    void compute(int core, int cycles); // Spend cycles of the current gap
+    void enqueueRequests(std::vector<BusRequest> &brs, int cycle, int core);
+    void promotePrefetch(int core, uint32_t address); // Queued prefetch now has a demand waiting
+    bool busIdle(int cycle) const;     // Nothing would use the bus this cycle
+    void drainWriteBuffers(int cycle); // Queue one buffered writeback if the bus is idle
+
+    // Probe the other caches for a bus request; combines their responses, with the
+    // transfer time of the first cache that can supply the data
+    void snoopCaches(const BusRequest &br, int cycle, SnoopResponse &combined);
 };
\ No newline at end of file
@@ -0,0 +1,164 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary simulator checkpoints. Values are written as raw host-order bytes, so a
+// checkpoint is only meant to be restored by the same build on the same machine;
+// the header's magic, version and configuration string catch everything else.
+class CheckpointWriter
+{
+public:
+    explicit CheckpointWriter(std::ostream &out) : out(out) {}
+
+    template <typename T>
+    void put(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "raw values only");
+        out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void put(const std::vector<T> &values)
+    {
+        put<uint64_t>(values.size());
+        for (const T &value : values)
+            put(value);
+    }
+
+    template <typename T>
+    void put(const std::deque<T> &values)
+    {
+        put<uint64_t>(values.size());
+        for (const T &value : values)
+            put(value);
+    }
+
+    template <typename T>
+    void put(const std::optional<T> &value)
+    {
+        put<bool>(value.has_value());
+        if (value)
+            put(*value);
+    }
+
+    void put(const std::string &value)
+    {
+        put<uint64_t>(value.size());
+        out.write(value.data(), value.size());
+    }
+
+    bool ok() const { return static_cast<bool>(out); }
+
+private:
+    std::ostream &out;
+};
+
+class CheckpointReader
+{
+public:
+    explicit CheckpointReader(std::istream &in) : in(in) {}
+
+    // Every get leaves the target untouched once the stream has failed
+    template <typename T>
+    void get(T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "raw values only");
+        Raw<T> raw;
+        if (read(raw))
+            std::memcpy(&value, raw.bytes, sizeof(T));
+    }
+
+    template <typename T>
+    void get(std::vector<T> &values)
+    {
+        uint64_t size = 0;
+        if (!getSize(size))
+            return;
+        values.clear();
+        Raw<T> raw;
+        for (uint64_t i = 0; i < size && read(raw); ++i)
+            values.push_back(raw.value());
+    }
+
+    // A vector whose length the configuration fixes; any other length marks the
+    // checkpoint malformed
+    template <typename T>
+    void get(std::vector<T> &values, size_t expected)
+    {
+        get(values);
+        if (in && values.size() != expected)
+            fail();
+    }
+
+    template <typename T>
+    void get(std::deque<T> &values)
+    {
+        uint64_t size = 0;
+        if (!getSize(size))
+            return;
+        values.clear();
+        Raw<T> raw;
+        for (uint64_t i = 0; i < size && read(raw); ++i)
+            values.push_back(raw.value());
+    }
+
+    template <typename T>
+    void get(std::optional<T> &value)
+    {
+        bool present = false;
+        get(present);
+        Raw<T> raw;
+        if (!present)
+            value.reset();
+        else if (read(raw))
+            value = raw.value();
+    }
+
+    void get(std::string &value)
+    {
+        uint64_t size = 0;
+        if (!getSize(size))
+            return;
+        value.assign(size, '\0');
+        in.read(&value[0], size);
+    }
+
+    bool ok() const { return static_cast<bool>(in); }
+    // Reject a value that no consistent checkpoint holds, as a short read does
+    void fail() { in.setstate(std::ios::failbit); }
+
+private:
+    std::istream &in;
+
+    // Storage for one value of a type that need not be default constructible
+    template <typename T>
+    struct Raw
+    {
+        alignas(T) char bytes[sizeof(T)];
+        const T &value() const { return *reinterpret_cast<const T *>(bytes); }
+    };
+
+    template <typename T>
+    bool read(Raw<T> &raw)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "raw values only");
+        return static_cast<bool>(in.read(raw.bytes, sizeof(T)));
+    }
+
+    // Reject sizes no well-formed checkpoint could hold before allocating for them
+    bool getSize(uint64_t &size)
+    {
+        get(size);
+        if (in && size > MAX_ELEMENTS)
+            in.setstate(std::ios::failbit);
+        return static_cast<bool>(in);
+    }
+    static constexpr uint64_t MAX_ELEMENTS = uint64_t(1) << 32;
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+
+// Cache coherence states: MESI, plus OWNED for MOESI and FORWARD for MESIF
+enum class MESIState
+{
+    MODIFIED,
+    EXCLUSIVE,
+    SHARED,
+    INVALID,
+    OWNED,  // Dirty, possibly shared; this cache answers reads and writes the block back
+    FORWARD // Clean and shared; the one copy that answers reads
+};
+
+const int COHERENCE_STATES = 6;
+
+// Snooped bus requests, as far as the protocol is concerned
+enum class SnoopEvent
+{
+    READ,           // BusRd
+    READ_EXCLUSIVE, // BusRdX
+    UPGRADE         // BusUpgr
+};
+
+const int SNOOP_EVENTS = 3;
+
+// What a cache holding the block does when it snoops an event
+struct SnoopAction
+{
+    MESIState next;
+    bool supplies; // Sends its copy to the requester
+    bool flushes;  // Writes its dirty copy back to memory
+};
+
+// A coherence protocol as a lookup table over (state, snooped event)
+struct ProtocolTable
+{
+    const char *name;
+    SnoopAction snoop[COHERENCE_STATES][SNOOP_EVENTS];
+    MESIState shared_read_state; // Requester's state after a read miss other caches also hold
+
+    const SnoopAction &onSnoop(MESIState state, SnoopEvent event) const
+    {
+        return snoop[static_cast<int>(state)][static_cast<int>(event)];
+    }
+};
+
+// States whose copy is newer than memory and must be written back on eviction
+inline bool isDirtyState(MESIState state)
+{
+    return state == MESIState::MODIFIED || state == MESIState::OWNED;
+}
+
+// States that must invalidate other copies before a write
+inline bool needsUpgrade(MESIState state)
+{
+    return state == MESIState::SHARED || state == MESIState::OWNED || state == MESIState::FORWARD;
+}
+
+// Names accepted by findProtocol, for usage messages
+extern const char *const PROTOCOL_NAMES;
+
+// "mesi", "moesi" or "mesif"; nullptr for an unknown name
+const ProtocolTable *findProtocol(const std::string &name);
@@ -1,23 +1,25 @@
 #pragma once
 #include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <string>
-#include <list>
+#include "ReplacementPolicy.h"
+#include "Prefetcher.h"
+#include "CoherenceProtocol.h"
+#include "MissProfiler.h"
+#include "LatencyHistogram.h"
+#include "Checkpoint.h"
 
-// MESI cache coherence states
-enum class MESIState
-{
-    MODIFIED,
-    EXCLUSIVE,
-    SHARED,
-    INVALID
-};
+class SnoopFilter;
 
 // Reference to a memory operation
 struct MemRef
 {
     bool is_write;
     uint32_t address;
+    uint32_t gap = 0; // Compute cycles (non-memory instructions) before this reference
 };
 
 // Bus operations for coherence protocol
@@ -27,9 +29,16 @@ enum class BusOperation
     BUS_RDX,
     BUS_UPGR,
     FLUSH,
-    FLUSH_OPT
+    FLUSH_OPT,
+    EVICT_CLEAN // Clean victim handed to an exclusive L2
 };
 
+// Operations that carry an evicted block away from an L1
+inline bool isVictimTransfer(BusOperation op)
+{
+    return op == BusOperation::FLUSH || op == BusOperation::FLUSH_OPT || op == BusOperation::EVICT_CLEAN;
+}
+
 // A request on the bus
 struct BusRequest
 {
@@ -38,55 +47,173 @@ struct BusRequest
     uint32_t address;
     int start_cycle;
     int duration;
+    bool is_prefetch = false; // Issued by the prefetcher, ranks below demand requests...
+    bool promoted = false;    // ...unless a demand access has come to wait on it
+    int grant_cycle = 0;      // Cycle the bus was granted, for latency statistics
+    bool from_write_buffer = false; // Buffered writeback drained on an idle bus
     BusRequest(int id, BusOperation op, uint32_t addr, int cycle, int dur)
         : core_id(id), operation(op), address(addr), start_cycle(cycle), duration(dur) {}
 };
 
+// A cache's answer to a snooped bus request
+struct SnoopResponse
+{
+    bool provide_data = false; // Supplies the block to the requester
+    int transfer_cycles = 0;
+    bool had_copy = false;     // Held the block when the request was snooped
+    bool flushed = false;      // Wrote its dirty copy back to memory
+    bool invalidated = false;  // Lost its copy to the request
+};
+
 // Core statistics
 struct CoreStats
 {
-    int read_count = 0;
-    int write_count = 0;
-    int instruction_count = 0; // count of completed instructions
-    int execution_cycles = 0;
-    int idle_cycles = 0;
-    int cache_misses = 0;
-    int cache_hits = 0;
-    int evictions = 0;
-    int writebacks = 0;
+    long long read_count = 0;
+    long long write_count = 0;
+    long long instruction_count = 0; // count of completed instructions
+    long long execution_cycles = 0;
+    long long idle_cycles = 0;
+    long long compute_cycles = 0; // Execution cycles spent in trace gaps, between references
+    long long cache_misses = 0;
+    long long cache_hits = 0;
+    long long evictions = 0;
+    long long writebacks = 0;
+    // Non-blocking mode only
+    long long mshr_merges = 0;           // Secondary misses merged into an existing MSHR
+    long long mshr_full_stalls = 0;      // Accesses stalled because every MSHR was busy
+    long long mshr_occupancy_cycles = 0; // Sum over cycles of the MSHRs in use
+    long long mshr_peak = 0;             // Most MSHRs in use at once
+    // Write buffer only
+    long long wb_buffered = 0;     // Dirty victims parked in the write buffer
+    long long wb_full_stalls = 0;  // Victims that found the buffer full and forced a flush
+    long long wb_forwards = 0;     // Snoops answered from the write buffer
+    long long wb_drain_cycles = 0; // Bus cycles of buffered writebacks, spent off any miss's path
+    // Prefetcher only
+    long long prefetches_issued = 0;
+    long long prefetch_hits = 0;   // Prefetched lines whose first demand access hit
+    long long prefetch_late = 0;   // Demand misses on a block whose prefetch was still in flight
+    long long prefetch_unused = 0; // Prefetched lines evicted or invalidated before any use
 };
 
-// A single cache line
-struct CacheLine
+// What a demand access that cannot complete at once is waiting for
+enum class AccessKind : uint8_t
 {
-    bool valid = false;
-    uint32_t tag = 0;
-    MESIState state = MESIState::INVALID;
-    std::vector<uint8_t> data;
+    READ_MISS,
+    WRITE_MISS,
+    UPGRADE // Write hit on a line other caches may share
 };
+const int ACCESS_KINDS = 3;
+
+// End-to-end latency of demand accesses: cycles from an access's first attempt
+// until the cache holds its block in the state it needs
+struct AccessLatency
+{
+    LatencyHistogram by_kind[ACCESS_KINDS];
+};
+
+// Miss Status Holding Register: one outstanding miss or upgrade for a block
+struct MSHR
+{
+    uint32_t address;           // Address of the primary miss
+    BusOperation operation;     // Request on the bus: BUS_RD, BUS_RDX or BUS_UPGR
+    int issue_cycle;            // First attempt of the primary access
+    bool pending_write = false; // A merged write needs the block in M once it arrives
+    AccessKind kind = AccessKind::READ_MISS; // Of the primary access
+};
+
+// Tag stored in ways that hold no valid line. Real tags are address >> (s + b)
+// with s, b >= 1, so they never reach this value.
+const uint32_t INVALID_TAG = 0xFFFFFFFF;
 
 class L1Cache
 {
 public:
+    // Address decomposition shared with the analysis tools
+    static int setIndexOf(uint32_t address, int s_bits, int b_bits)
+    {
+        return (address >> b_bits) & ((1 << s_bits) - 1);
+    }
+    static uint32_t tagOf(uint32_t address, int s_bits, int b_bits)
+    {
+        return address >> (s_bits + b_bits);
+    }
+
     L1Cache(int core_id, int s_bits, int b_bits, int assoc);
+    void enableDataTracking(); // Allocate a data payload for every line
+    void attachSnoopFilter(SnoopFilter *filter); // Report fills and invalidations to filter
+    void setDebug(bool enabled);                 // Log every request and completion
+    void setMshrs(int count);                    // Non-blocking with `count` MSHRs (0 = blocking)
+    void setWriteBuffer(int depth);              // Park up to `depth` dirty victims (0 = none)
+    void setReplacementPolicy(std::unique_ptr<ReplacementPolicy> replacement); // LRU by default
+    void attachPrefetcher(std::unique_ptr<Prefetcher> prefetcher_model);
+    void setCleanEvictions(bool enabled);        // Send clean victims on the bus too (exclusive L2)
+    void setProtocol(const ProtocolTable *table); // Coherence protocol for snoops (MESI by default)
+    void attachMissProfiler(std::unique_ptr<MissProfiler> profiler);
+    const MissProfiler *getMissProfiler() const { return miss_profiler.get(); }
+    void enableAccessLatency(); // Time every demand access that waits on the bus
+    const AccessLatency *getAccessLatency() const { return access_latency.get(); }
     CoreStats getStats() const;
     bool isBlocked() const;
     void unblock(int cycle);
+    bool hasOutstandingMisses() const; // Non-blocking mode: MSHRs still in use
+    void waitForMisses(int cycle);     // Block until an outstanding miss completes
     void recordInstruction(bool is_write); // record completed instruction
 
+    // Write buffer: the simulator drains the oldest entry when the bus is idle
+    bool hasBufferedWriteback() const;
+    uint32_t popBufferedWriteback();
+
     // Process a memory request. Returns true if hit, false if miss or upgrade.
     // bus_reqs is filled with 0, 1, or 2 BusRequests to enqueue for eviction and/or miss.
     bool processMemoryRequest(const MemRef &mem_ref, int current_cycle,
                               std::vector<BusRequest> &bus_reqs);
 
     // Handle a bus request from another core for snooping
-    void handleBusRequest(const BusRequest &bus_req, int current_cycle,
-                          bool &provide_data, int &transfer_cycles);
+    void handleBusRequest(const BusRequest &bus_req, int current_cycle, SnoopResponse &response);
 
-    // Complete a memory request after a bus transaction finishes
-    void completeMemoryRequest(int current_cycle, bool is_upgrade,
+    // Complete a memory request for address after a bus transaction finishes.
+    // In non-blocking mode the fill may evict a line or need a follow-up request,
+    // which are added to bus_reqs.
+    void completeMemoryRequest(int current_cycle, uint32_t address, bool is_upgrade,
                                bool received_data_from_cache,
-                               MESIState new_state);
+                               MESIState new_state, std::vector<BusRequest> &bus_reqs);
+
+    // Fill a prefetched block once its BUS_RD finishes, handing it to a demand
+    // access that is waiting on it
+    void completePrefetch(int current_cycle, uint32_t address, MESIState new_state,
+                          std::vector<BusRequest> &bus_reqs);
+    // Invalidate the block for an inclusive L2 eviction, dropping a buffered
+    // writeback of it too. Returns whether it was held, and sets dirty if the
+    // copy or the buffered writeback was dirty.
+    bool backInvalidate(uint32_t address, bool &dirty);
+    // Block addresses of the valid lines and of the write buffer's entries
+    std::vector<uint32_t> heldBlocks() const;
+
+    // After processMemoryRequest: the address of a demand miss that is now waiting
+    // on a prefetch, so the prefetch can be raised to demand priority
+    bool takeLatePrefetch(uint32_t &address);
+
+    // Functional accesses, for sampled warming and the functional mode, only while
+    // no request is outstanding. warmAccess applies the access with no timing: it
+    // returns false for a hit, or the bus operation a miss or upgrade needs. A miss
+    // evicts at once, leaving the victim's writeback (FLUSH or EVICT_CLEAN) in
+    // eviction. warmFill then installs the block, or the upgraded state, once the
+    // caller has snooped the others. Hits, misses, evictions and writebacks are
+    // counted as processMemoryRequest counts them, once per access.
+    bool warmAccess(const MemRef &mem_ref, BusOperation &op, std::optional<BusOperation> &eviction,
+                    uint32_t &victim_address);
+    void warmFill(const MemRef &mem_ref, BusOperation op, MESIState new_state);
+
+    // Parallel engine lookahead: whether processMemoryRequest would complete
+    // mem_ref from this cache alone, with no bus request and no prefetch. Hits
+    // change no tags, so a run of them can be checked before any is applied.
+    bool hitsLocally(const MemRef &mem_ref) const;
+
+    // Lines, replacement and prefetcher state, outstanding misses and statistics,
+    // for checkpoints. The miss profiler and the (never written) data payload are
+    // not included.
+    void saveState(CheckpointWriter &out) const;
+    void loadState(CheckpointReader &in);
 
     void printCacheState() const;
     std::string stateToString(MESIState state) const;
@@ -94,6 +221,8 @@ public:
     // Methods for simulation loop to account cycles
     void addExecutionCycle(int cycles);
     void addIdleCycle(int cycles);
+    void addComputeCycles(int cycles); // Trace gap cycles, counted as execution
+    void addDrainCycles(int cycles);   // A buffered writeback held the bus this long
 
 private:
     int core_id;
@@ -103,13 +232,79 @@ private:
     int s; // set index bits
     int b; // block offset bits
 
-    std::vector<std::list<CacheLine>> cache_sets;
+    // Flat set storage: way w of set i lives at index i * E + w
+    std::vector<uint32_t> tags;      // INVALID_TAG unless the line is valid
+    std::vector<MESIState> states;
+    std::vector<uint8_t> allocated;  // 0 while the way is free for a fill
+    std::unique_ptr<ReplacementPolicy> policy;
+    std::vector<uint8_t> data;       // S * E * B payload bytes, only with data tracking
     CoreStats stats;
     bool is_blocked = false;
     MemRef pending_request;
+    int filled_line = -1; // Line filled for pending_request, until the access is retried
+    int reserved_line = -1; // Way freed for pending_request's fill
+    bool retrying = false;  // The last access did not complete and will be presented again
+    int access_start = 0;   // First attempt of the current access
+    AccessKind access_kind = AccessKind::READ_MISS; // Blocking mode: what the retried access waits for
+    SnoopFilter *snoop_filter = nullptr;
+    bool debug = false;
+
+    // Non-blocking mode: outstanding misses, at most mshr_count of them
+    int mshr_count = 0;
+    std::vector<MSHR> mshrs;
+    int occupancy_since = 0; // Cycle the MSHR occupancy last changed
+
+    // Write buffer: block addresses of dirty victims awaiting writeback, oldest first
+    int write_buffer_depth = 0;
+    std::deque<uint32_t> write_buffer;
 
     int getSetIndex(uint32_t address) const;
     uint32_t getTag(uint32_t address) const;
-    CacheLine *findLineByTag(int set_index, uint32_t tag);
-    void moveToFront(int set_index, std::list<CacheLine>::iterator it);
+    int findWay(int set_index, uint32_t tag) const; // Line index of a valid match, or -1
+    uint32_t lineAddress(int line) const;           // Block address of a valid line
+    void touch(int line);                           // Report a demand hit to the policy
+    void invalidate(int line);
+    int chooseFillWay(int set_index, int skip_line = -1); // Free way, else the policy's victim (-1 if skip_line)
+    void fill(int line, uint32_t address, MESIState state);
+
+    bool processBlocking(const MemRef &mem_ref, int current_cycle, std::vector<BusRequest> &bus_reqs);
+    bool processNonBlocking(const MemRef &mem_ref, int current_cycle, std::vector<BusRequest> &bus_reqs);
+    void completeNonBlocking(int current_cycle, uint32_t address, bool is_upgrade,
+                             MESIState new_state, std::vector<BusRequest> &bus_reqs);
+    MSHR *findMshr(uint32_t address);
+    void trackOccupancy(int current_cycle); // Accumulate occupancy up to current_cycle
+
+    // Write back a dirty victim through the buffer, or straight to the bus without one.
+    // Returns true if the writeback was buffered.
+    void writeBack(uint32_t victim_addr, int current_cycle, std::vector<BusRequest> &bus_reqs);
+    void removeBuffered(std::deque<uint32_t>::iterator entry); // Drop an entry and its filter bit
+    void recallWriteback(uint32_t address, int current_cycle, std::vector<BusRequest> &bus_reqs);
+    // Prefetching: blocks with a prefetch on the bus, at most MAX_PREFETCHES of them
+    static constexpr int MAX_PREFETCHES = 8;
+    std::unique_ptr<Prefetcher> prefetcher;
+    std::vector<uint32_t> prefetch_blocks;
+    std::vector<uint8_t> prefetched; // Per line: filled by a prefetch and not used yet
+    bool waiting_for_prefetch = false; // Blocking mode: pending_request waits on a prefetch
+    std::optional<uint32_t> late_prefetch; // Reported by takeLatePrefetch
+    bool clean_evictions = false;
+    const ProtocolTable *protocol;
+    std::unique_ptr<MissProfiler> miss_profiler; // Null unless miss profiling is on
+    std::unique_ptr<AccessLatency> access_latency; // Null unless latency statistics are on
+
+    // Non-blocking mode: accesses merged into an MSHR, timed until it completes
+    struct MergedAccess
+    {
+        uint32_t block;
+        int start_cycle;
+        AccessKind kind;
+    };
+    std::vector<MergedAccess> merged_accesses; // Only kept with access_latency
+
+    void issuePrefetches(uint32_t address, bool trigger, int current_cycle, std::vector<BusRequest> &bus_reqs);
+    bool prefetchInFlight(uint32_t address) const;
+    void evictLine(int line, int current_cycle, std::vector<BusRequest> &bus_reqs);
+    void finishMshr(MSHR *mshr, int line, MESIState new_state, int current_cycle,
+                    std::vector<BusRequest> &bus_reqs);
+
+    void snoopWriteBuffer(const BusRequest &bus_req, SnoopResponse &response);
 };
\ No newline at end of file
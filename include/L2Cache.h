@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ReplacementPolicy.h"
+#include "Checkpoint.h"
+
+// How the shared L2 relates to the L1s above it
+enum class InclusionPolicy
+{
+    INCLUSIVE, // Every block in an L1 is also in the L2; L2 evictions invalidate the L1 copies
+    EXCLUSIVE, // The L2 only holds L1 victims; a block moves up to the L1 on an L2 hit
+    NINE       // Non-inclusive non-exclusive: fills go to both, evictions are independent
+};
+
+struct L2Stats
+{
+    long long hits = 0;
+    long long misses = 0;
+    long long evictions = 0;
+    long long writebacks = 0;         // Dirty L2 victims written to memory
+    long long back_invalidations = 0; // L1 copies invalidated by inclusive L2 evictions
+};
+
+// Shared last-level cache between the snooping bus and memory. It tracks tags
+// and a dirty bit per line; coherence stays in the L1s.
+class L2Cache
+{
+public:
+    L2Cache(int s_bits, int assoc, int b_bits, std::unique_ptr<ReplacementPolicy> replacement);
+
+    // A block displaced by insert
+    struct Victim
+    {
+        bool valid = false;
+        uint32_t address = 0;
+        bool dirty = false;
+    };
+
+    bool contains(uint32_t address) const;
+    bool access(uint32_t address, bool &dirty); // Demand lookup; a hit updates the replacement state
+    void remove(uint32_t address);
+    // Write the block, allocating it if absent; returns what had to be evicted
+    Victim insert(uint32_t address, bool dirty);
+
+    int getBlockBits() const { return b; }
+    int getAssociativity() const { return E; }
+    long long sizeBytes() const { return static_cast<long long>(S) * E << b; }
+    const char *policyName() const { return policy->name(); }
+    void saveState(CheckpointWriter &out) const;
+    void loadState(CheckpointReader &in);
+    L2Stats stats;
+
+private:
+    int S, E, s, b;
+    std::vector<uint32_t> tags;
+    std::vector<uint8_t> valid;
+    std::vector<uint8_t> dirty_bits;
+    std::unique_ptr<ReplacementPolicy> policy;
+
+    int findLine(uint32_t address) const; // Line index, or -1
+};
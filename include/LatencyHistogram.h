@@ -0,0 +1,22 @@
+#pragma once
+#include <map>
+
+// Distribution of latencies in cycles. Values are kept exactly (one counter per
+// distinct latency), which stays small because bus latencies repeat.
+class LatencyHistogram
+{
+public:
+    void add(int cycles);
+
+    long long count() const { return samples; }
+    double mean() const;
+    // Smallest latency with at least `percent` of the samples at or below it
+    int percentile(double percent) const;
+    int max() const;
+    const std::map<int, long long> &counts() const { return histogram; }
+
+private:
+    std::map<int, long long> histogram;
+    long long samples = 0;
+    long long sum = 0;
+};
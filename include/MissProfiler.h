@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Access, miss and eviction counts, with misses split by cause
+struct MissCounts
+{
+    long long accesses = 0;
+    long long misses = 0;
+    long long evictions = 0;
+    long long compulsory = 0; // First reference to the block by this core
+    long long capacity = 0;   // Would miss in a fully associative LRU cache of the same size
+    long long conflict = 0;   // Would hit in that cache
+    long long coherence = 0;  // The block was invalidated by another core's write
+};
+
+// Per-core miss profile: counters per set and per address region, and a
+// 3C + coherence classification of each miss. A shadow fully associative LRU
+// cache with as many lines as the L1 separates capacity from conflict misses.
+class MissProfiler
+{
+public:
+    MissProfiler(int s_bits, int assoc, int b_bits, int region_bits);
+
+    void access(uint32_t address, bool hit);   // Each demand reference, on its first attempt
+    // A way of `set` reallocated; victim_address is empty if a snoop had already
+    // invalidated the line
+    void eviction(int set, std::optional<uint32_t> victim_address);
+    void invalidation(uint32_t address);       // A snoop took the block away
+
+    const MissCounts &totals() const { return total; }
+    // The `count` sets with the most misses, most first
+    std::vector<int> hottestSets(int count) const;
+    const MissCounts &setCounts(int set) const { return sets[set]; }
+
+    // CSV rows of core,set|region_start,accesses,misses,evictions,compulsory,capacity,conflict,coherence
+    static void writeCsvHeader(std::ostream &out, const char *key);
+    void writeSetRows(std::ostream &out, int core_id) const;
+    void writeRegionRows(std::ostream &out, int core_id) const;
+
+private:
+    int s, b, region_bits;
+    size_t shadow_lines;
+    std::vector<MissCounts> sets;
+    std::map<uint32_t, MissCounts> regions; // Keyed by region number, in address order
+    MissCounts total;
+
+    std::list<uint32_t> shadow; // Block numbers, most recent first
+    std::unordered_map<uint32_t, std::list<uint32_t>::iterator> shadow_index;
+    std::unordered_set<uint32_t> seen;        // Blocks referenced so far
+    std::unordered_set<uint32_t> invalidated; // Blocks lost to snoops and not referenced since
+
+    bool shadowAccess(uint32_t block); // Whether the fully associative cache hits; updates it
+    static void writeRow(std::ostream &out, int core_id, uint32_t key, const MissCounts &counts);
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// Hardware prefetcher in front of one core's L1. It watches that core's demand
+// accesses, at block granularity, and suggests blocks to fetch ahead of use.
+class Prefetcher
+{
+public:
+    virtual ~Prefetcher() = default;
+
+    virtual const char *name() const = 0;
+
+    // Observe a demand access to block. trigger is set for a miss, or for the first
+    // hit on a prefetched line (which would have missed without the prefetch).
+    // Blocks to prefetch are appended to candidates.
+    virtual void observe(uint32_t block, bool trigger, std::vector<uint32_t> &candidates) = 0;
+
+    // Training state, for checkpoints
+    virtual void save(CheckpointWriter &out) const = 0;
+    virtual void load(CheckpointReader &in) = 0;
+};
+
+// Names accepted by makePrefetcher, for usage messages
+extern const char *const PREFETCHER_NAMES;
+
+// "next-line", "stride" or "stream", each fetching up to degree blocks ahead.
+// Returns nullptr for an unknown name.
+std::unique_ptr<Prefetcher> makePrefetcher(const std::string &name, int degree);
@@ -0,0 +1,31 @@
+#pragma once
+#include <memory>
+#include <string>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// Chooses which way of a full set to evict. The cache reports every demand hit
+// and every fill; snoops and other lookups are not reported, so they never
+// change the replacement order. Updates are O(1) per access for every policy.
+class ReplacementPolicy
+{
+public:
+    virtual ~ReplacementPolicy() = default;
+
+    virtual const char *name() const = 0;
+    virtual void onHit(int set, int way) = 0;
+    virtual void onFill(int set, int way) = 0;
+    virtual int victim(int set) = 0; // Way to evict from a set whose ways are all in use
+
+    // Replacement state, including random number generators, for checkpoints
+    virtual void save(CheckpointWriter &out) const = 0;
+    virtual void load(CheckpointReader &in) = 0;
+};
+
+// Names accepted by makeReplacementPolicy, for usage messages
+extern const char *const REPLACEMENT_POLICY_NAMES;
+
+// "lru", "plru" (tree pseudo-LRU), "srrip", "brrip", "fifo" or "random".
+// Returns nullptr for an unknown name.
+std::unique_ptr<ReplacementPolicy> makeReplacementPolicy(const std::string &name, int sets, int ways);
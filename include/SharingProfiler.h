@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Per-block sharing profile. For every block it records which parts each core
+// reads and writes, at a granule of 4 bytes (coarser for blocks over 256 bytes,
+// so a block fits 64 granules), and how often a core's copy is invalidated by
+// another core's write. A contended block is true sharing when one core writes a
+// granule another core uses, and false sharing when the cores only touch
+// disjoint granules and the block ping-pongs purely because they share a line.
+class SharingProfiler
+{
+public:
+    SharingProfiler(int cores, int b_bits);
+
+    void access(int core, uint32_t address, bool is_write); // One completed reference
+    void invalidation(uint32_t address);                    // A snoop invalidated a core's copy
+
+    // The `top` most invalidated contended blocks, each with a heatmap of which
+    // granules every core read (r), wrote (w) or both (b)
+    void printReport(std::ostream &out, int top) const;
+    // Rows of: Sharing Block,address,invalidations,cores using it,false|true
+    void writeCsvRows(std::ostream &out, int top) const;
+
+private:
+    struct CoreUse
+    {
+        uint64_t read_mask = 0;
+        uint64_t write_mask = 0;
+    };
+    struct BlockSharing
+    {
+        std::vector<CoreUse> cores;
+        long long invalidations = 0;
+    };
+    using RankedBlock = std::pair<uint32_t, const BlockSharing *>;
+
+    int num_cores;
+    int b;
+    int granule_bits;
+    int granules; // Per block, at most 64
+    std::unordered_map<uint32_t, BlockSharing> blocks; // Keyed by block number
+
+    BlockSharing &block(uint32_t address);
+    static bool isContended(const BlockSharing &sharing);
+    static bool isTrueSharing(const BlockSharing &sharing);
+    std::vector<RankedBlock> ranked(int top) const;
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Checkpoint.h"
+
+// Inclusive presence directory: for every block held valid by at least one L1,
+// a bitmask of the cores holding it. Caches report fills and invalidations, and
+// the bus only probes the cores whose bit is set.
+class SnoopFilter
+{
+public:
+    explicit SnoopFilter(int b_bits) : b(b_bits) {}
+
+    void add(int core_id, uint32_t address);
+    void remove(int core_id, uint32_t address);
+    uint64_t sharers(uint32_t address) const; // Bit i set if core i holds the block
+    // Parallel epochs: hold each core's updates in a list of its own while the
+    // cores run on separate threads, then apply them all. Nothing reads the
+    // filter in between, and each core only changes its own bit.
+    void deferUpdates(int cores);
+    void applyDeferred();
+    void saveState(CheckpointWriter &out) const;
+    void loadState(CheckpointReader &in);
+
+    long long probes = 0;          // Snoop probes actually sent to a cache
+    long long probes_filtered = 0; // Probes skipped because the core cannot hold the block
+
+private:
+    int b; // Block offset bits
+    std::unordered_map<uint32_t, uint64_t> presence;
+    bool deferring = false;
+    std::vector<std::vector<std::pair<uint32_t, bool>>> deferred; // Per core: block address, added
+};
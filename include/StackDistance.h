@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Single-pass LRU stack-distance profile of one core's reference stream.
+// For every set count 2^0 .. 2^max_s_bits at a fixed block size, each set keeps
+// an LRU stack of its most recent max_assoc tags. An access found at depth d hits
+// in every cache of that set count with associativity > d, so one pass gives hit
+// and miss counts for all (sets, associativity) pairs up to the limits.
+class StackDistanceProfiler
+{
+public:
+    StackDistanceProfiler(int b_bits, int max_s_bits, int max_assoc);
+
+    void access(uint32_t address);
+
+    long long accesses() const { return total_accesses; }
+    // Misses of an LRU cache with 2^s_bits sets and E ways
+    long long misses(int s_bits, int E) const;
+
+    // Miss-rate table: one row per set count, one column per power-of-two E
+    void printCurve(std::ostream &out, int core_id) const;
+    // Every (s, E) pair as CSV rows: core,s,E,accesses,misses,miss_rate
+    static void writeCsvHeader(std::ostream &out);
+    void writeCsvRows(std::ostream &out, int core_id) const;
+
+private:
+    int b;
+    int max_s;
+    int max_assoc;
+    long long total_accesses = 0;
+
+    // Per set-index width: flat stacks (set * max_assoc + depth, MRU first),
+    // their fill levels, and the hit count at each depth
+    std::vector<std::vector<uint32_t>> stacks;
+    std::vector<std::vector<int>> depths;
+    std::vector<std::vector<long long>> hits_at_depth;
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "CacheSimulator.h"
+
+// One point of a parameter sweep
+struct CacheConfig
+{
+    int s;
+    int E;
+    int b;
+};
+
+// Run one CacheSimulator per configuration on a pool of `threads` workers. The
+// traces are loaded once and shared read-only by every simulator; configure
+// applies the common command-line options to each one. Writes all per-core
+// results, in configuration order, as a single CSV.
+bool runSweep(const std::string &trace_name, int cores, const std::vector<CacheConfig> &configs,
+              int threads, const std::function<void(CacheSimulator &)> &configure,
+              std::ostream &csv, bool report_perf);
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Way lookup over one set's contiguous tag array. Ways holding no valid line
+// store INVALID_TAG, so a plain equality compare is enough.
+
+// Index of the first way whose tag equals tag, or -1
+inline int matchTagScalar(const uint32_t *tags, int ways, uint32_t tag)
+{
+    for (int w = 0; w < ways; ++w)
+    {
+        if (tags[w] == tag)
+            return w;
+    }
+    return -1;
+}
+
+// Same result as matchTagScalar, comparing 8 (AVX2) or 4 (SSE2) ways per step
+inline int matchTag(const uint32_t *tags, int ways, uint32_t tag)
+{
+    int w = 0;
+#if defined(__AVX2__)
+    const __m256i key8 = _mm256_set1_epi32(static_cast<int>(tag));
+    for (; w + 8 <= ways; w += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tags + w));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, key8)));
+        if (mask)
+            return w + __builtin_ctz(mask);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i key4 = _mm_set1_epi32(static_cast<int>(tag));
+    for (; w + 4 <= ways; w += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tags + w));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, key4)));
+        if (mask)
+            return w + __builtin_ctz(mask);
+    }
+#endif
+    int rest = matchTagScalar(tags + w, ways - w, tag);
+    return rest < 0 ? -1 : w + rest;
+}
+
+// Name of the compiled-in lookup path, for reports
+inline const char *tagMatchPath()
+{
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
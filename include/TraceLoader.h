@@ -0,0 +1,91 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "L1Cache.h"
+
+// Parse text trace records ("R 0x1A2B" / "W 4096", one per line) straight out of
+// a byte range. Blank lines and trailing whitespace are skipped, and lines without
+// an address are ignored. An optional third field gives the compute gap before
+// the reference: a count of cycles ("R 0x1A2B 12"), or the absolute cycle the
+// reference issued at ("R 0x1A2B @1500"), turned into the gap since the previous
+// record. Returns the number of records appended to refs.
+size_t parseTextTrace(const char *begin, const char *end, std::vector<MemRef> &refs);
+
+// Incremental form of parseTextTrace: stops after max_records and returns a
+// pointer just past the last byte consumed. clock is the cycle after the
+// previous record issued (0 at the start of a trace), carried for timestamps.
+const char *parseTextRecords(const char *begin, const char *end, std::vector<MemRef> &refs,
+                             size_t max_records, uint64_t &clock);
+
+// Gaps saturate here, so a core's cycle count stays within an int
+const uint32_t MAX_TRACE_GAP = (1u << 30) - 1;
+
+// Packed binary trace format. A 16-byte header (magic, version, record count)
+// is followed by one LEB128 varint per record holding the zigzag-encoded address
+// delta from the previous record, shifted left once with the W bit in bit 0.
+// Version 2 follows each of those with a second varint holding the compute gap.
+const char BINARY_TRACE_MAGIC[4] = {'L', '1', 'T', 'B'};
+const uint8_t BINARY_TRACE_VERSION = 1;
+const uint8_t BINARY_TRACE_VERSION_GAPS = 2;
+const size_t BINARY_TRACE_HEADER_SIZE = 16;
+
+bool isBinaryTrace(const char *begin, const char *end);
+// gaps is set for a version 2 trace
+bool parseBinaryHeader(const char *begin, const char *end, uint64_t &count, bool &gaps);
+
+// Decode up to max_records records, carrying the running address and the number
+// of records still expected. Stops before a record that is cut off by end and
+// returns a pointer to the first byte not consumed.
+const char *decodeBinaryRecords(const char *begin, const char *end, bool gaps, uint32_t &address,
+                                uint64_t &remaining, std::vector<MemRef> &refs, size_t max_records);
+
+// Decode a binary trace image (header included). Returns false if it is
+// truncated or carries an unknown version.
+bool parseBinaryTrace(const char *begin, const char *end, std::vector<MemRef> &refs);
+
+// Encode refs as a binary trace image, header included. Version 1 is written
+// unless some record has a gap.
+void encodeBinaryTrace(const std::vector<MemRef> &refs, std::string &out);
+
+// Memory-map a trace file and parse it without copying, detecting text or
+// binary format from the header. bytes_read receives the file size. Returns
+// false if the file cannot be opened, mapped or decoded.
+bool loadTraceFile(const std::string &filename, std::vector<MemRef> &refs, size_t &bytes_read);
+
+// Reads a trace file of either format through a fixed-size byte buffer, so the
+// memory used does not depend on the trace length
+class TraceReader
+{
+public:
+    TraceReader() = default;
+    ~TraceReader();
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    bool open(const std::string &filename, size_t buffer_bytes = 1 << 20);
+
+    // Append up to max_records records to refs. Returns 0 once the trace is exhausted.
+    size_t read(std::vector<MemRef> &refs, size_t max_records);
+
+    bool hasFailed() const { return failed; }
+    size_t bytesRead() const { return bytes_read; }
+
+private:
+    int fd = -1;
+    std::vector<char> buffer;
+    size_t head = 0; // First unconsumed byte in buffer
+    size_t tail = 0; // One past the last valid byte in buffer
+    bool eof = false;
+    bool failed = false;
+    size_t bytes_read = 0;
+
+    bool binary = false;
+    bool gaps = false;      // Binary records carry a gap varint
+    uint32_t address = 0;   // Running address for delta decoding
+    uint64_t remaining = 0; // Records left according to the binary header
+    uint64_t clock = 0;     // Text timestamps: cycle after the previous record
+
+    void fillBuffer();
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "L1Cache.h"
+
+// One core's view of its trace. Either walks a fully loaded trace, or streams the
+// file through two fixed-size chunks: the core consumes one while a background
+// thread decodes the next, so memory stays constant whatever the trace length.
+class TraceStream
+{
+public:
+    TraceStream();
+    ~TraceStream();
+    TraceStream(TraceStream &&) noexcept;
+    TraceStream &operator=(TraceStream &&) noexcept;
+
+    // Walk a trace that is already in memory (may be shared between simulators)
+    void attach(std::shared_ptr<const std::vector<MemRef>> refs);
+
+    // Stream a trace file in chunks of chunk_records records
+    bool openStreaming(const std::string &filename, size_t chunk_records);
+
+    // True once every record has been consumed (may wait for the prefetch thread)
+    bool atEnd()
+    {
+        return cur == end && !nextChunk();
+    }
+    const MemRef &peek() const { return *cur; }
+    void advance() { ++cur; }
+    // Lookahead within the records already decoded: peek(k) for k < buffered()
+    size_t buffered() const { return end - cur; }
+    const MemRef &peek(size_t ahead) const { return cur[ahead]; }
+
+    size_t position() const; // Records consumed so far
+    // Consume the first `records` records, to resume at a checkpoint's position;
+    // false if the trace is shorter
+    bool seek(size_t records);
+    bool hasFailed() const;  // Streamed file was malformed (valid once atEnd())
+
+private:
+    struct Prefetcher;
+
+    std::shared_ptr<const std::vector<MemRef>> loaded;
+    std::unique_ptr<Prefetcher> prefetcher;
+    std::vector<MemRef> front; // Chunk being consumed in streaming mode
+    const MemRef *begin = nullptr;
+    const MemRef *cur = nullptr;
+    const MemRef *end = nullptr;
+    size_t consumed_before = 0; // Records in chunks already retired
+
+    bool nextChunk();
+};
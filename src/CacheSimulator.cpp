@@ -1,10 +1,17 @@
 #include "../include/CacheSimulator.h"
+#include "../include/TraceLoader.h"
 #include <iostream>
-#include <sstream>
+#include <chrono>
+#include <filesystem>
 #include <iomanip> // Add for formatted output
-
-// Reference the global DEBUG_MODE variable defined in main.cpp
-extern bool DEBUG_MODE;
+#include <sys/resource.h>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <sstream>
+#include <atomic>
+#include <functional>
+#include <thread>
 
 // Helper function to get string representation of bus operation
 std::string busOpToString(BusOperation op)
@@ -19,357 +26,1925 @@ std::string busOpToString(BusOperation op)
         return "BUS_UPGR";
     case BusOperation::FLUSH:
         return "FLUSH";
+    case BusOperation::FLUSH_OPT:
+        return "FLUSH_OPT";
+    case BusOperation::EVICT_CLEAN:
+        return "EVICT_CLEAN";
     default:
         return "UNKNOWN";
     }
 }
 
-// Helper function to print bus queue contents for debugging (priority_queue version)
-void printBusQueue(std::priority_queue<BusRequest, std::vector<BusRequest>, BusRequestComparator> queue)
+// LatencyStats category of a bus request
+int latencyCategory(const BusRequest &br)
+{
+    if (br.is_prefetch)
+        return LatencyStats::PREFETCH;
+    switch (br.operation)
+    {
+    case BusOperation::BUS_RD:
+        return LatencyStats::BUS_RD;
+    case BusOperation::BUS_RDX:
+        return LatencyStats::BUS_RDX;
+    case BusOperation::BUS_UPGR:
+        return LatencyStats::BUS_UPGR;
+    case BusOperation::FLUSH:
+        return LatencyStats::FLUSH;
+    case BusOperation::FLUSH_OPT:
+        return LatencyStats::FLUSH_OPT;
+    case BusOperation::EVICT_CLEAN:
+        return LatencyStats::EVICT_CLEAN;
+    }
+    return LatencyStats::BUS_RD;
+}
+
+// Row label for a LatencyStats category
+const char *latencyCategoryName(int category)
+{
+    static const char *const names[LatencyStats::CATEGORIES] = {
+        "BUS_RD", "BUS_RDX", "BUS_UPGR", "FLUSH", "FLUSH_OPT", "EVICT_CLEAN", "PREFETCH"};
+    return names[category];
+}
+
+// Row label for an AccessLatency kind
+const char *accessKindName(int kind)
+{
+    static const char *const names[ACCESS_KINDS] = {"READ_MISS", "WRITE_MISS", "UPGRADE"};
+    return names[kind];
+}
+
+void printLatencyRow(const char *operation, const char *metric, const LatencyHistogram &h)
+{
+    std::cout << "  " << std::left << std::setw(12) << operation << std::setw(12) << metric << std::right
+              << std::setw(10) << h.count() << std::setw(12) << std::fixed << std::setprecision(2) << h.mean()
+              << std::setw(9) << h.percentile(50) << std::setw(9) << h.percentile(95)
+              << std::setw(9) << h.percentile(99) << std::setw(9) << h.max() << std::endl;
+}
+
+// Helper function to print bus queue contents for debugging (priority_queue version)
+void printBusQueue(std::priority_queue<BusRequest, std::vector<BusRequest>, BusRequestComparator> queue)
+{
+    if (queue.empty())
+    {
+        std::cout << "    Queue: [empty]" << std::endl;
+        return;
+    }
+
+    std::cout << "    Queue: [";
+
+    while (!queue.empty())
+    {
+        const BusRequest &br = queue.top();
+        std::cout << "Core" << br.core_id << ":"
+                  << busOpToString(br.operation)
+                  << ":0x" << std::hex << br.address << std::dec;
+
+        queue.pop();
+        if (!queue.empty())
+        {
+            std::cout << ", ";
+        }
+    }
+    std::cout << "]" << std::endl;
+}
+
+CacheSimulator::CacheSimulator(int s, int E, int b, int cores)
+    : num_cores(cores), s_bits(s), E_assoc(E), b_bits(b)
+{
+    for (int i = 0; i < num_cores; ++i)
+    {
+        caches.emplace_back(i, s_bits, b_bits, E_assoc);
+    }
+    core_bus_stats.resize(num_cores); // Initialize per-core bus stats
+}
+
+void CacheSimulator::setDebug(bool enabled)
+{
+    debug = enabled;
+    for (auto &cache : caches)
+        cache.setDebug(enabled);
+}
+
+void CacheSimulator::setCycleSkipping(bool enabled)
+{
+    cycle_skipping = enabled;
+}
+
+void CacheSimulator::setSplitBus(int max_outstanding)
+{
+    split_bus_slots = max_outstanding;
+}
+
+void CacheSimulator::setMshrs(int count)
+{
+    mshrs_per_cache = count;
+    for (auto &cache : caches)
+        cache.setMshrs(count);
+}
+
+void CacheSimulator::setWriteBuffer(int depth)
+{
+    write_buffer_depth = depth;
+    for (auto &cache : caches)
+        cache.setWriteBuffer(depth);
+}
+
+bool CacheSimulator::setReplacementPolicy(const std::string &name)
+{
+    for (auto &cache : caches)
+    {
+        auto policy = makeReplacementPolicy(name, 1 << s_bits, E_assoc);
+        if (!policy)
+            return false;
+        replacement_name = policy->name();
+        cache.setReplacementPolicy(std::move(policy));
+    }
+    return true;
+}
+
+bool CacheSimulator::setPrefetcher(const std::string &name, int degree)
+{
+    for (auto &cache : caches)
+    {
+        auto prefetcher = makePrefetcher(name, degree);
+        if (!prefetcher)
+            return false;
+        prefetcher_name = prefetcher->name();
+        cache.attachPrefetcher(std::move(prefetcher));
+    }
+    prefetch_degree = degree;
+    return true;
+}
+
+bool CacheSimulator::setProtocol(const std::string &name)
+{
+    const ProtocolTable *table = findProtocol(name);
+    if (!table)
+        return false;
+    protocol = table;
+    for (auto &cache : caches)
+        cache.setProtocol(table);
+    return true;
+}
+
+bool CacheSimulator::enableL2(int s, int E, int b, int latency, const std::string &policy_name, InclusionPolicy policy)
+{
+    auto replacement = makeReplacementPolicy(policy_name, 1 << s, E);
+    if (!replacement)
+        return false;
+    l2 = std::make_unique<L2Cache>(s, E, b, std::move(replacement));
+    l2_latency = latency;
+    inclusion = policy;
+    // An exclusive L2 is filled by L1 victims only, clean ones included
+    for (auto &cache : caches)
+        cache.setCleanEvictions(policy == InclusionPolicy::EXCLUSIVE);
+    return true;
+}
+
+void CacheSimulator::setSampling(long long period, long long window, long long warmup)
+{
+    sample_period = period;
+    sample_window = window;
+    sample_warmup = warmup;
+}
+
+void CacheSimulator::setFunctional(bool enabled)
+{
+    functional = enabled;
+}
+
+void CacheSimulator::setParallel(int threads)
+{
+    parallel_threads = threads;
+}
+
+void CacheSimulator::setStreaming(size_t chunk_records)
+{
+    stream_chunk_records = chunk_records;
+}
+
+void CacheSimulator::enableDataTracking()
+{
+    for (auto &cache : caches)
+        cache.enableDataTracking();
+}
+
+int CacheSimulator::countTraceFiles(const std::string &app_name)
+{
+    int count = 0;
+    while (std::filesystem::exists(app_name + "_proc" + std::to_string(count) + ".trace"))
+        ++count;
+    return count;
+}
+
+bool CacheSimulator::readTraces(const std::string &app_name, int cores, SharedTraces &refs, size_t &bytes)
+{
+    refs.clear();
+    bytes = 0;
+    for (int i = 0; i < cores; ++i)
+    {
+        // Construct trace filename - ensure proper path handling
+        std::string filename = app_name + "_proc" + std::to_string(i) + ".trace";
+
+        auto core_refs = std::make_shared<std::vector<MemRef>>();
+        size_t file_bytes = 0;
+        if (!loadTraceFile(filename, *core_refs, file_bytes))
+        {
+            std::cerr << "Error: Could not load trace file: '" << filename << "'" << std::endl;
+            return false;
+        }
+        refs.push_back(std::move(core_refs));
+        bytes += file_bytes;
+    }
+    return true;
+}
+
+void CacheSimulator::setTracePrefix(const std::string &app_name)
+{
+    // For output display, extract just the base name
+    size_t lastSlash = app_name.rfind('/');
+    if (lastSlash != std::string::npos)
+    {
+        trace_prefix = app_name.substr(lastSlash + 1);
+    }
+    else
+    {
+        trace_prefix = app_name;
+    }
+}
+
+void CacheSimulator::attachTraces(const std::string &app_name, const SharedTraces &refs)
+{
+    setTracePrefix(app_name);
+    traces.clear();
+    traces.resize(num_cores);
+    for (int i = 0; i < num_cores; ++i)
+        traces[i].attach(refs[i]);
+}
+
+bool CacheSimulator::loadTraces(const std::string &app_name)
+{
+    auto load_start = std::chrono::steady_clock::now();
+
+    if (stream_chunk_records == 0)
+    {
+        SharedTraces refs;
+        if (!readTraces(app_name, num_cores, refs, trace_bytes))
+            return false;
+        attachTraces(app_name, refs);
+    }
+    else
+    {
+        setTracePrefix(app_name);
+        traces.clear();
+        traces.resize(num_cores);
+        for (int i = 0; i < num_cores; ++i)
+        {
+            std::string filename = app_name + "_proc" + std::to_string(i) + ".trace";
+            std::error_code ec;
+            uintmax_t file_bytes = std::filesystem::file_size(filename, ec);
+            if (ec || !traces[i].openStreaming(filename, stream_chunk_records))
+            {
+                std::cerr << "Error: Could not open trace file: '" << filename << "'" << std::endl;
+                return false;
+            }
+            trace_bytes += file_bytes;
+        }
+    }
+
+    trace_load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start).count();
+    return true;
+}
+
+void CacheSimulator::enableSnoopFilter()
+{
+    snoop_filter = std::make_unique<SnoopFilter>(b_bits);
+    for (auto &cache : caches)
+        cache.attachSnoopFilter(snoop_filter.get());
+}
+
+void CacheSimulator::enableSharingReport(int top)
+{
+    sharing = std::make_unique<SharingProfiler>(num_cores, b_bits);
+    sharing_top = top;
+}
+
+void CacheSimulator::enableMissProfile(int region_bits)
+{
+    for (auto &cache : caches)
+        cache.attachMissProfiler(std::make_unique<MissProfiler>(s_bits, E_assoc, b_bits, region_bits));
+}
+
+bool CacheSimulator::writeMissProfile(const std::string &prefix) const
+{
+    std::ofstream sets_csv(prefix + "_sets.csv");
+    std::ofstream regions_csv(prefix + "_regions.csv");
+    if (!sets_csv || !regions_csv)
+    {
+        std::cerr << "Error: Could not write miss profile " << prefix << "_*.csv" << std::endl;
+        return false;
+    }
+    MissProfiler::writeCsvHeader(sets_csv, "set");
+    MissProfiler::writeCsvHeader(regions_csv, "region_start");
+    for (int i = 0; i < num_cores; ++i)
+    {
+        const MissProfiler *profile = caches[i].getMissProfiler();
+        if (!profile)
+            continue;
+        profile->writeSetRows(sets_csv, i);
+        profile->writeRegionRows(regions_csv, i);
+    }
+    return true;
+}
+
+void CacheSimulator::enableLatencyStats()
+{
+    latency.assign(num_cores, LatencyStats());
+    for (L1Cache &cache : caches)
+        cache.enableAccessLatency();
+}
+
+bool CacheSimulator::writeLatencyHistograms(const std::string &path) const
+{
+    std::ofstream csv(path);
+    if (!csv)
+    {
+        std::cerr << "Error: Could not write latency histograms " << path << std::endl;
+        return false;
+    }
+    csv << "core,operation,metric,cycles,count\n";
+    auto write = [&](int core, const char *operation, const char *metric, const LatencyHistogram &h)
+    {
+        for (const auto &entry : h.counts())
+            csv << core << "," << operation << "," << metric << "," << entry.first << "," << entry.second << "\n";
+    };
+    for (int i = 0; i < static_cast<int>(latency.size()); ++i)
+    {
+        for (int c = 0; c < LatencyStats::CATEGORIES; ++c)
+        {
+            write(i, latencyCategoryName(c), "queue_wait", latency[i].queue_wait[c]);
+            write(i, latencyCategoryName(c), "service", latency[i].service[c]);
+        }
+        const AccessLatency &access = *caches[i].getAccessLatency();
+        for (int k = 0; k < ACCESS_KINDS; ++k)
+            write(i, accessKindName(k), "end_to_end", access.by_kind[k]);
+    }
+    return true;
+}
+
+void CacheSimulator::printLatency() const
+{
+    std::cout << "Latency (cycles): bus queue wait and service per request, end-to-end per access" << std::endl;
+    for (int i = 0; i < static_cast<int>(latency.size()); ++i)
+    {
+        std::cout << "Core " << i << ":" << std::endl;
+        std::cout << "  " << std::left << std::setw(12) << "Operation" << std::setw(12) << "Metric" << std::right
+                  << std::setw(10) << "Count" << std::setw(12) << "Mean" << std::setw(9) << "p50"
+                  << std::setw(9) << "p95" << std::setw(9) << "p99" << std::setw(9) << "Max" << std::endl;
+        for (int c = 0; c < LatencyStats::CATEGORIES; ++c)
+        {
+            if (latency[i].service[c].count() == 0)
+                continue;
+            printLatencyRow(latencyCategoryName(c), "queue wait", latency[i].queue_wait[c]);
+            printLatencyRow(latencyCategoryName(c), "service", latency[i].service[c]);
+        }
+        const AccessLatency &access = *caches[i].getAccessLatency();
+        for (int k = 0; k < ACCESS_KINDS; ++k)
+        {
+            if (access.by_kind[k].count() > 0)
+                printLatencyRow(accessKindName(k), "end-to-end", access.by_kind[k]);
+        }
+    }
+}
+
+namespace
+{
+    // Ratio estimate of sum(y) / sum(x) over the sampled units, with the half-width
+    // of its 95% confidence interval (NaN below two units)
+    void estimateRatio(const std::vector<double> &y, const std::vector<double> &x, double &ratio,
+                       double &half_width)
+    {
+        double sum_y = 0.0, sum_x = 0.0;
+        for (size_t j = 0; j < y.size(); ++j)
+        {
+            sum_y += y[j];
+            sum_x += x[j];
+        }
+        ratio = sum_x > 0 ? sum_y / sum_x : 0.0;
+        half_width = std::numeric_limits<double>::quiet_NaN();
+        size_t n = y.size();
+        if (n < 2 || sum_x <= 0)
+            return;
+
+        // Residuals of each unit against the pooled ratio
+        double squares = 0.0;
+        for (size_t j = 0; j < n; ++j)
+        {
+            double residual = y[j] - ratio * x[j];
+            squares += residual * residual;
+        }
+        half_width = 1.96 * std::sqrt(squares / (n - 1) / n) / (sum_x / n);
+    }
+
+    void printInterval(std::ostream &out, double half_width, const char *unit = "")
+    {
+        if (std::isnan(half_width))
+            out << "n/a";
+        else
+            out << half_width << unit;
+    }
+}
+
+void CacheSimulator::printSampling(std::ofstream &outfile) const
+{
+    // System cycles per reference, from the measured windows
+    std::vector<double> window_cycles, window_refs;
+    for (const SamplePeriod &period : samples)
+    {
+        if (period.window_refs == 0)
+            continue;
+        window_cycles.push_back(static_cast<double>(period.window_cycles));
+        window_refs.push_back(static_cast<double>(period.window_refs));
+    }
+    double cpr, cpr_interval;
+    estimateRatio(window_cycles, window_refs, cpr, cpr_interval);
+    if (window_refs.empty())
+        std::cerr << "Warning: No window was measured; the sampling period is longer than the trace" << std::endl;
+
+    long long total_refs = 0;
+    double total_cycles_estimate = 0.0, total_cycles_interval = 0.0;
+    for (int i = 0; i < num_cores; ++i)
+    {
+        // A core's time is the detailed cycles it spent plus every functional
+        // stretch it was still running through, at that period's cycles per reference
+        double cycles = 0.0;
+        long long active = 0;
+        std::vector<double> misses, refs;
+        for (const SamplePeriod &period : samples)
+        {
+            double period_cpr = period.window_refs > 0
+                                    ? static_cast<double>(period.window_cycles) / period.window_refs
+                                    : cpr;
+            cycles += period.active_refs[i] * period_cpr + period.detailed_cycles[i];
+            active += period.active_refs[i];
+            if (period.refs[i] > 0)
+            {
+                misses.push_back(static_cast<double>(period.misses[i]));
+                refs.push_back(static_cast<double>(period.refs[i]));
+            }
+        }
+        double cycles_interval = cpr_interval * active;
+        double miss_ratio, miss_interval;
+        estimateRatio(misses, refs, miss_ratio, miss_interval);
+        long long measured = 0;
+        for (double r : refs)
+            measured += static_cast<long long>(r);
+        long long core_refs = static_cast<long long>(traces[i].position());
+        total_refs += core_refs;
+
+        // Cores run side by side, so the last to finish sets the run time
+        if (cycles > total_cycles_estimate)
+        {
+            total_cycles_estimate = cycles;
+            total_cycles_interval = cycles_interval;
+        }
+
+        std::cout << "Core " << i << " Estimates:" << std::endl;
+        std::cout << "Total Instructions: " << core_refs << std::endl;
+        std::cout << "Measured Instructions: " << measured << " (" << refs.size() << " windows)" << std::endl;
+        std::cout << std::fixed << std::setprecision(0);
+        std::cout << "Estimated Execution Cycles: " << cycles << " +/- ";
+        printInterval(std::cout, cycles_interval);
+        std::cout << std::endl
+                  << std::setprecision(2);
+        std::cout << "Estimated Cache Miss Rate: " << 100.0 * miss_ratio << "% +/- ";
+        printInterval(std::cout, 100.0 * miss_interval, "%");
+        std::cout << std::endl
+                  << std::endl;
+
+        if (outfile.is_open())
+        {
+            outfile << "Core," << i << "\n"
+                    << "Total Instructions," << core_refs << "\n"
+                    << "Measured Instructions," << measured << "\n"
+                    << "Measured Windows," << refs.size() << "\n"
+                    << "Estimated Execution Cycles," << cycles << "\n"
+                    << "Execution Cycles 95% CI," << cycles_interval << "\n"
+                    << "Estimated Cache Miss Rate," << 100.0 * miss_ratio << "\n"
+                    << "Cache Miss Rate 95% CI," << 100.0 * miss_interval << "\n\n";
+        }
+    }
+
+    // Host time a fully detailed run would take, at the detailed phases' speed
+    long long detailed_refs = total_refs - functional_refs;
+    double detailed_seconds = simulation_seconds - functional_seconds;
+    double full_seconds = detailed_refs > 0 ? detailed_seconds * total_refs / detailed_refs : 0.0;
+    double speedup = simulation_seconds > 0 ? full_seconds / simulation_seconds : 0.0;
+    double detailed_percent = total_refs > 0 ? 100.0 * detailed_refs / total_refs : 0.0;
+
+    std::cout << "Sampling Summary:" << std::endl;
+    std::cout << std::setprecision(0) << "Estimated Total Cycles: " << total_cycles_estimate << " +/- ";
+    printInterval(std::cout, total_cycles_interval);
+    std::cout << std::endl;
+    std::cout << "Detailed References: " << detailed_refs << " (" << std::setprecision(2) << detailed_percent
+              << "%)" << std::endl;
+    std::cout << "Functionally Warmed References: " << functional_refs << std::endl;
+    std::cout << "Simulation Time (ms): " << simulation_seconds * 1000.0 << std::endl;
+    std::cout << "Estimated Full Detailed Time (ms): " << full_seconds * 1000.0 << std::endl;
+    std::cout << "Estimated Speedup: " << speedup << "x" << std::endl;
+
+    if (outfile.is_open())
+    {
+        outfile << "Sampling Summary\n"
+                << "Estimated Total Cycles," << total_cycles_estimate << "\n"
+                << "Total Cycles 95% CI," << total_cycles_interval << "\n"
+                << "Detailed References," << detailed_refs << "\n"
+                << "Functionally Warmed References," << functional_refs << "\n"
+                << "Simulation Time (ms)," << simulation_seconds * 1000.0 << "\n"
+                << "Estimated Full Detailed Time (ms)," << full_seconds * 1000.0 << "\n"
+                << "Estimated Speedup," << speedup << "\n";
+    }
+}
+
+void CacheSimulator::snoopCaches(const BusRequest &br, int cycle, SnoopResponse &combined)
+{
+    combined = SnoopResponse();
+
+    // Without a filter every other core is probed; with one, only the holders
+    uint64_t holders = ~uint64_t(0);
+    if (snoop_filter)
+    {
+        holders = snoop_filter->sharers(br.address);
+        int candidates = num_cores - 1;
+        int probed = __builtin_popcountll(holders & ~(uint64_t(1) << br.core_id));
+        snoop_filter->probes += probed;
+        snoop_filter->probes_filtered += candidates - probed;
+    }
+
+    for (int i = 0; i < num_cores; ++i)
+    {
+        if (i == br.core_id || !(holders & (uint64_t(1) << i)))
+            continue;
+
+        SnoopResponse response;
+        caches[i].handleBusRequest(br, cycle, response);
+
+        // The first cache able to supply the block services the request
+        if (response.provide_data && !combined.provide_data)
+        {
+            combined.provide_data = true;
+            combined.transfer_cycles = response.transfer_cycles;
+        }
+        combined.had_copy |= response.had_copy;
+        combined.flushed |= response.flushed;
+        if (sharing && response.invalidated)
+            sharing->invalidation(br.address);
+    }
+}
+
+void CacheSimulator::beginTransaction(const BusRequest &br, int cycle, bool &data_from_cache,
+                                      MESIState &new_state, int &duration)
+{
+    // Count this transaction
+    bus_stats.transactions++;
+    core_bus_stats[br.core_id].transactions++;
+
+    if (debug)
+    {
+        std::cout << "[CYCLE " << std::setw(6) << cycle << "] "
+                  << "BUS: Core " << br.core_id << " starts "
+                  << busOpToString(br.operation)
+                  << " for address 0x" << std::hex << br.address << std::dec << std::endl;
+    }
+
+    // Snooping - process properly based on the bus operation
+    data_from_cache = false;
+    int transfer_cycles = 0;
+    new_state = MESIState::INVALID;
+    SnoopResponse snoop;
+
+    // Updated based on clarification #21: Read miss allows cache-to-cache transfer, write miss always from memory
+    if (br.operation == BusOperation::BUS_RD)
+    {
+        // For read miss, check other caches for the data (cache-to-cache transfer allowed)
+        snoopCaches(br, cycle, snoop);
+        data_from_cache = snoop.provide_data;
+        transfer_cycles = snoop.transfer_cycles;
+
+        // Read miss, set appropriate state
+        new_state = snoop.had_copy ? protocol->shared_read_state : MESIState::EXCLUSIVE;
+    }
+    else if (br.operation == BusOperation::BUS_RDX)
+    {
+        // For write miss, always fetch from memory per clarification #21
+        // But still need to invalidate in other caches
+        snoopCaches(br, cycle, snoop);
+
+        // Always set to MODIFIED for write miss
+        new_state = MESIState::MODIFIED;
+        data_from_cache = false; // Force memory access for write miss
+    }
+    else if (br.operation == BusOperation::BUS_UPGR)
+    {
+        // Invalidate in other caches
+        snoopCaches(br, cycle, snoop);
+        new_state = MESIState::MODIFIED;
+        data_from_cache = false;
+    }
+
+    // Calculate bus transaction duration
+    if (isVictimTransfer(br.operation))
+    {
+        duration = MEMORY_LATENCY; // Writeback to memory
+    }
+    else if (br.operation == BusOperation::BUS_RD)
+    {
+        // For read miss, use cache-to-cache if available
+        if (data_from_cache)
+        {
+            duration = transfer_cycles; // Cache-to-cache transfer (typically 2*N cycles)
+        }
+        else
+        {
+            duration = MEMORY_LATENCY; // Memory access
+        }
+    }
+    else if (br.operation == BusOperation::BUS_RDX)
+    {
+        // For write miss, always use memory
+        duration = MEMORY_LATENCY; // Memory access
+    }
+    else // BUS_UPGR
+    {
+        duration = 1; // Just invalidation signals
+    }
+
+    // With an L2, data that no cache supplies comes from (or goes to) the L2
+    bool from_memory = br.operation != BusOperation::BUS_UPGR && !(br.operation == BusOperation::BUS_RD && data_from_cache);
+    if (l2 && from_memory)
+        duration = accessL2(br, new_state);
+
+    // Update bus stats
+    if (br.operation == BusOperation::BUS_UPGR || br.operation == BusOperation::BUS_RDX)
+    {
+        bus_stats.invalidations++;
+        core_bus_stats[br.core_id].invalidations++;
+    }
+
+    // Update data traffic stats
+    if (br.operation == BusOperation::BUS_RD && data_from_cache)
+    {
+        // For cache-to-cache transfers on read miss
+        int blockSize = caches[br.core_id].getBlockSize();
+        bus_stats.data_traffic_bytes += blockSize;
+        core_bus_stats[br.core_id].data_traffic_bytes += blockSize;
+    }
+    else if (br.operation == BusOperation::BUS_RD || br.operation == BusOperation::BUS_RDX ||
+             isVictimTransfer(br.operation))
+    {
+        // For memory transfers, count full block size
+        int blockSize = caches[br.core_id].getBlockSize();
+        bus_stats.data_traffic_bytes += blockSize;
+        core_bus_stats[br.core_id].data_traffic_bytes += blockSize;
+    }
+    if (br.operation == BusOperation::BUS_RD && snoop.flushed)
+    {
+        // The supplier's dirty copy also goes to memory as the block becomes shared
+        int blockSize = caches[br.core_id].getBlockSize();
+        bus_stats.data_traffic_bytes += blockSize;
+        core_bus_stats[br.core_id].data_traffic_bytes += blockSize;
+        if (l2)
+        {
+            bus_stats.l2_traffic_bytes += blockSize;
+            core_bus_stats[br.core_id].l2_traffic_bytes += blockSize;
+            insertL2(br.core_id, br.address, true);
+        }
+    }
+    if (br.is_prefetch)
+    {
+        int blockSize = caches[br.core_id].getBlockSize();
+        bus_stats.prefetch_traffic_bytes += blockSize;
+        core_bus_stats[br.core_id].prefetch_traffic_bytes += blockSize;
+    }
+}
+
+int CacheSimulator::accessL2(const BusRequest &br, MESIState &new_state)
+{
+    int block_size = caches[br.core_id].getBlockSize();
+    BusStats &core_stats = core_bus_stats[br.core_id];
+    if (isVictimTransfer(br.operation))
+    {
+        bus_stats.l2_traffic_bytes += block_size;
+        core_stats.l2_traffic_bytes += block_size;
+        insertL2(br.core_id, br.address, br.operation != BusOperation::EVICT_CLEAN);
+        return l2_latency;
+    }
+
+    bool l2_dirty = false;
+    if (l2->access(br.address, l2_dirty))
+    {
+        bus_stats.l2_traffic_bytes += block_size;
+        core_stats.l2_traffic_bytes += block_size;
+        if (inclusion == InclusionPolicy::EXCLUSIVE)
+        {
+            // The block moves up; a dirty one leaves the L1 as its only up-to-date
+            // copy, unless other caches share it and the L2 keeps the writeback
+            if (!l2_dirty || new_state == MESIState::EXCLUSIVE || new_state == MESIState::MODIFIED)
+                l2->remove(br.address);
+            if (l2_dirty && new_state == MESIState::EXCLUSIVE)
+                new_state = MESIState::MODIFIED;
+        }
+        return l2_latency;
+    }
+
+    int l2_block_size = 1 << l2->getBlockBits();
+    bus_stats.memory_traffic_bytes += l2_block_size;
+    core_stats.memory_traffic_bytes += l2_block_size;
+    if (inclusion != InclusionPolicy::EXCLUSIVE)
+        insertL2(br.core_id, br.address, false);
+    return MEMORY_LATENCY;
+}
+
+void CacheSimulator::insertL2(int core, uint32_t address, bool dirty)
+{
+    // L2 victims are written to memory off the bus, so they cost no bus cycles
+    L2Cache::Victim victim = l2->insert(address, dirty);
+    if (!victim.valid)
+        return;
+    if (victim.dirty)
+    {
+        int l2_block_size = 1 << l2->getBlockBits();
+        bus_stats.memory_traffic_bytes += l2_block_size;
+        core_bus_stats[core].memory_traffic_bytes += l2_block_size;
+    }
+    if (inclusion == InclusionPolicy::INCLUSIVE)
+        backInvalidate(victim.address);
+}
+
+void CacheSimulator::backInvalidate(uint32_t address)
+{
+    // An L2 block may span several L1 blocks; dirty L1 copies go straight to
+    // memory, charged to the core whose cache held them
+    int block_size = 1 << b_bits;
+    int l2_block_size = 1 << l2->getBlockBits();
+    for (int offset = 0; offset < l2_block_size; offset += block_size)
+    {
+        for (int i = 0; i < num_cores; ++i)
+        {
+            bool dirty = false;
+            if (!caches[i].backInvalidate(address + offset, dirty))
+                continue;
+            l2->stats.back_invalidations++;
+            if (dirty)
+            {
+                bus_stats.memory_traffic_bytes += block_size;
+                core_bus_stats[i].memory_traffic_bytes += block_size;
+            }
+        }
+    }
+}
+
+long long CacheSimulator::countInclusionViolations() const
+{
+    long long missing = 0;
+    for (const L1Cache &cache : caches)
+    {
+        for (uint32_t address : cache.heldBlocks())
+            missing += l2->contains(address) ? 0 : 1;
+    }
+    return missing;
+}
+
+void CacheSimulator::recordLatency(const BusRequest &br, int cycle)
+{
+    if (latency.empty())
+        return;
+    int category = latencyCategory(br);
+    LatencyStats &stats = latency[br.core_id];
+    stats.queue_wait[category].add(br.grant_cycle - br.start_cycle);
+    stats.service[category].add(cycle - br.grant_cycle);
+}
+
+void CacheSimulator::finishTransaction(const BusRequest &br, int cycle, bool data_from_cache, MESIState new_state)
+{
+    auto &cache = caches[br.core_id];
+    std::vector<BusRequest> brs;
+    recordLatency(br, cycle);
+
+    // On the split bus other fills may have displaced the block from an inclusive
+    // L2 since its lookup; the L2 takes it again as the data crosses the bus
+    bool fills = br.operation == BusOperation::BUS_RD || br.operation == BusOperation::BUS_RDX;
+    if (l2 && inclusion == InclusionPolicy::INCLUSIVE && fills && !l2->contains(br.address))
+        insertL2(br.core_id, br.address, false);
+
+    if (br.is_prefetch)
+    {
+        cache.completePrefetch(cycle, br.address, new_state, brs);
+    }
+    else if (br.operation == BusOperation::BUS_UPGR)
+    {
+        cache.completeMemoryRequest(cycle, br.address, true, false, new_state, brs);
+    }
+    else if (br.operation == BusOperation::BUS_RD || br.operation == BusOperation::BUS_RDX)
+    {
+        cache.completeMemoryRequest(cycle, br.address, false, data_from_cache, new_state, brs);
+    }
+    // A FLUSH is the writeback half of an eviction. The core stays blocked
+    // until its demand request (queued alongside) completes.
+
+    // Non-blocking caches evict at fill time and may need a follow-up request
+    enqueueRequests(brs, cycle, br.core_id);
+}
+
+void CacheSimulator::stepAtomicBus(int cycle)
+{
+    // Start next bus transaction if bus is free
+    if (!bus_busy && !bus_queue.empty())
+    {
+        // Arbitration: pick the request from the lowest core ID (priority_queue)
+        BusRequest br = bus_queue.top();
+        bus_queue.pop();
+        br.grant_cycle = cycle;
+
+        if (debug)
+        {
+            std::cout << "[CYCLE " << std::setw(6) << cycle << "] "
+                      << "Arbitration: Selected core " << br.core_id << " bus request" << std::endl;
+        }
+        current_bus = br;
+
+        int duration;
+        beginTransaction(br, cycle, current_data_from_cache, current_new_state, duration);
+
+        bus_busy = true;
+        bus_free_cycle = cycle + duration;
+        if (br.from_write_buffer)
+            caches[br.core_id].addDrainCycles(duration);
+    }
+
+    // Complete bus transaction
+    if (bus_busy && cycle == bus_free_cycle)
+    {
+        if (current_bus.has_value())
+        {
+            finishTransaction(current_bus.value(), cycle, current_data_from_cache, current_new_state);
+        }
+
+        bus_busy = false;
+        current_bus = std::nullopt; // Use std::nullopt instead of reset() to avoid potential issues
+    }
+}
+
+int CacheSimulator::pickSplitRequest() const
+{
+    // The highest-priority request that can go now. One that must wait does not
+    // hold up the requests behind it, except those to the same block.
+    const std::vector<BusRequest> &queued = bus_queue.heap();
+    BusRequestComparator lower;
+    bool slot_free = static_cast<int>(in_flight.size()) < split_bus_slots;
+    int best = -1;
+    for (int k = 0; k < static_cast<int>(queued.size()); ++k)
+    {
+        const BusRequest &br = queued[k];
+        if (best >= 0 && !lower(queued[best], br))
+            continue;
+
+        // Upgrades carry no data and never occupy a memory slot
+        if (br.operation != BusOperation::BUS_UPGR && !slot_free)
+            continue;
+
+        // Keep one transaction per block in flight so a later request cannot
+        // overtake an earlier one to the same block
+        uint32_t block = br.address >> b_bits;
+        bool conflict = false;
+        for (const auto &txn : in_flight)
+            conflict = conflict || (txn.request.address >> b_bits) == block;
+        if (conflict)
+            continue;
+
+        // A request to the same block as a higher-priority one that waits must
+        // wait behind it
+        for (int j = 0; !conflict && j < static_cast<int>(queued.size()); ++j)
+            conflict = j != k && (queued[j].address >> b_bits) == block && lower(br, queued[j]);
+        if (!conflict)
+            best = k;
+    }
+    return best;
+}
+
+void CacheSimulator::stepSplitBus(int cycle)
+{
+    if (!bus_busy)
+    {
+        // Responses whose memory access has finished take the bus first, oldest first
+        int ready = -1;
+        for (int k = 0; k < static_cast<int>(in_flight.size()); ++k)
+        {
+            const auto &txn = in_flight[k];
+            if (!txn.awaiting_response || txn.ready_cycle > cycle)
+                continue;
+            if (ready < 0 || txn.ready_cycle < in_flight[ready].ready_cycle)
+                ready = k;
+        }
+
+        int pick = ready < 0 ? pickSplitRequest() : -1;
+        if (ready >= 0)
+        {
+            in_flight[ready].awaiting_response = false;
+            current_phase = BusPhase::RESPONSE;
+            current_txn = ready;
+            bus_busy = true;
+            bus_free_cycle = cycle + responseCycles();
+            bus_busy_cycles += responseCycles();
+        }
+        else if (pick >= 0)
+        {
+            BusRequest br = bus_queue.take(pick);
+            br.grant_cycle = cycle;
+
+            if (debug)
+            {
+                std::cout << "[CYCLE " << std::setw(6) << cycle << "] "
+                          << "Arbitration: Selected core " << br.core_id << " bus request" << std::endl;
+            }
+
+            SplitTransaction txn{br, false, MESIState::INVALID, 0, false};
+            int duration;
+            beginTransaction(br, cycle, txn.data_from_cache, txn.new_state, duration);
+            bus_busy = true;
+
+            if (br.operation == BusOperation::BUS_UPGR || (br.operation == BusOperation::BUS_RD && txn.data_from_cache))
+            {
+                // Invalidations and cache-to-cache transfers hold the bus throughout
+                current_phase = BusPhase::ATOMIC;
+                current_bus = br;
+                current_data_from_cache = txn.data_from_cache;
+                current_new_state = txn.new_state;
+                bus_free_cycle = cycle + duration;
+            }
+            else if (isVictimTransfer(br.operation))
+            {
+                // Writeback: the data goes out with the request, then memory absorbs
+                // it off the bus while the slot stays occupied
+                current_phase = BusPhase::REQUEST;
+                bus_free_cycle = cycle + responseCycles();
+                txn.ready_cycle = cycle + duration;
+                in_flight.push_back(txn);
+                current_txn = static_cast<int>(in_flight.size()) - 1;
+            }
+            else
+            {
+                // Memory read: address phase now, data returns in a response phase.
+                // Uncontended, the request and response together take `duration` cycles
+                // (MEMORY_LATENCY, or the L2 latency on an L2 hit).
+                current_phase = BusPhase::REQUEST;
+                bus_free_cycle = cycle + 1;
+                txn.ready_cycle = cycle + std::max(duration - responseCycles(), 1);
+                txn.awaiting_response = true;
+                in_flight.push_back(txn);
+                current_txn = static_cast<int>(in_flight.size()) - 1;
+            }
+            bus_busy_cycles += bus_free_cycle - cycle;
+            if (br.from_write_buffer)
+                caches[br.core_id].addDrainCycles(bus_free_cycle - cycle);
+            peak_in_flight = std::max(peak_in_flight, static_cast<int>(in_flight.size()));
+        }
+    }
+
+    // End of the current bus phase
+    if (bus_busy && cycle == bus_free_cycle)
+    {
+        if (current_phase == BusPhase::ATOMIC && current_bus.has_value())
+        {
+            finishTransaction(current_bus.value(), cycle, current_data_from_cache, current_new_state);
+            current_bus = std::nullopt;
+        }
+        else if (current_phase == BusPhase::RESPONSE)
+        {
+            SplitTransaction txn = in_flight[current_txn];
+            in_flight.erase(in_flight.begin() + current_txn);
+            finishTransaction(txn.request, cycle, txn.data_from_cache, txn.new_state);
+        }
+        bus_busy = false;
+        current_phase = BusPhase::NONE;
+    }
+
+    // Writebacks retire once memory has absorbed them
+    for (size_t k = 0; k < in_flight.size();)
+    {
+        const auto &txn = in_flight[k];
+        bool is_flush = isVictimTransfer(txn.request.operation);
+        bool on_bus = bus_busy && static_cast<int>(k) == current_txn;
+        if (is_flush && txn.ready_cycle <= cycle && !on_bus)
+        {
+            recordLatency(txn.request, cycle);
+            in_flight.erase(in_flight.begin() + k);
+            if (bus_busy && current_txn > static_cast<int>(k))
+                current_txn--;
+        }
+        else
+        {
+            ++k;
+        }
+    }
+}
+
+void CacheSimulator::promotePrefetch(int core, uint32_t address)
+{
+    // A priority_queue cannot reorder in place, so rebuild it with the prefetch
+    // ranked as a demand request. Prefetches already on the bus need nothing.
+    std::vector<BusRequest> pending;
+    while (!bus_queue.empty())
+    {
+        pending.push_back(bus_queue.top());
+        bus_queue.pop();
+    }
+    for (auto &r : pending)
+    {
+        if (r.is_prefetch && r.core_id == core && (r.address >> b_bits) == (address >> b_bits))
+            r.promoted = true;
+        bus_queue.push(r);
+    }
+}
+
+bool CacheSimulator::busIdle(int cycle) const
+{
+    if (bus_busy || !bus_queue.empty())
+        return false;
+    if (split_bus_slots == 0)
+        return true;
+
+    // A split bus is also taken by ready responses, and a writeback needs a free slot
+    if (static_cast<int>(in_flight.size()) >= split_bus_slots)
+        return false;
+    for (const auto &txn : in_flight)
+    {
+        if (txn.awaiting_response && txn.ready_cycle <= cycle)
+            return false;
+    }
+    return true;
+}
+
+void CacheSimulator::drainWriteBuffers(int cycle)
+{
+    if (!busIdle(cycle))
+        return;
+
+    // Same priority as bus arbitration: lowest core ID first
+    for (int i = 0; i < num_cores; ++i)
+    {
+        if (!caches[i].hasBufferedWriteback())
+            continue;
+
+        uint32_t address = caches[i].popBufferedWriteback();
+        if (debug)
+        {
+            std::cout << "[CYCLE " << std::setw(6) << cycle << "] "
+                      << "Core " << i << " drains write buffer entry 0x"
+                      << std::hex << address << std::dec << std::endl;
+        }
+        BusRequest br(i, BusOperation::FLUSH, address, cycle, MEMORY_LATENCY);
+        br.from_write_buffer = true;
+        bus_queue.push(br);
+        return;
+    }
+}
+
+int CacheSimulator::responseCycles() const
+{
+    // Same 2 cycles per word as a cache-to-cache transfer, leaving at least one
+    // cycle of the access to memory
+    return std::min(2 * ((1 << b_bits) / 4), MEMORY_LATENCY - 2);
+}
+
+int CacheSimulator::nextBusEvent(int cycle) const
+{
+    // Earliest cycle at which the bus can change state without new requests from
+    // the cores, or `cycle` if it may change right away
+    const int never = std::numeric_limits<int>::max();
+    if (write_buffer_depth > 0 && !bus_busy && bus_queue.empty())
+    {
+        // An idle bus drains the write buffers
+        for (const auto &cache : caches)
+        {
+            if (cache.hasBufferedWriteback())
+                return cycle;
+        }
+    }
+    if (split_bus_slots == 0)
+    {
+        if (bus_busy)
+            return bus_free_cycle;
+        return bus_queue.empty() ? never : cycle;
+    }
+
+    if (!bus_busy && pickSplitRequest() >= 0)
+        return cycle;
+    int next = bus_busy ? bus_free_cycle : never;
+    for (const auto &txn : in_flight)
+    {
+        bool is_flush = isVictimTransfer(txn.request.operation);
+        if (is_flush)
+            next = std::min(next, std::max(txn.ready_cycle, cycle));
+        else if (txn.awaiting_response && !bus_busy)
+            next = std::min(next, std::max(txn.ready_cycle, cycle)); // Otherwise waits for bus_free_cycle
+    }
+    return next;
+}
+
+void CacheSimulator::stepCores(int cycle, std::vector<bool> &done, int &remaining)
+{
+    // Process each core
+    for (int i = 0; i < num_cores; ++i)
+    {
+        if (!done[i] && !stepCore(i, cycle, nullptr))
+        {
+            done[i] = true;
+            --remaining;
+        }
+    }
+}
+
+bool CacheSimulator::stepCore(int i, int cycle, std::vector<EpochEvent> *log)
+{
+    if (caches[i].isBlocked())
+    {
+        caches[i].addIdleCycle(1); // Core is stalled waiting for cache miss or bus access
+        return true;
+    }
+
+    if (!draining && !traces[i].atEnd())
+    {
+        if (compute_left[i] > 0)
+        {
+            compute(i, 1); // Non-memory instructions ahead of the reference
+            return true;
+        }
+
+        const MemRef &ref = traces[i].peek();
+        std::vector<BusRequest> brs;
+        bool completed = caches[i].processMemoryRequest(ref, cycle, brs);
+        uint32_t late_address;
+        bool late = caches[i].takeLatePrefetch(late_address);
+        if (log)
+        {
+            if (!brs.empty() || late)
+                log->push_back({cycle, i, std::move(brs), late ? std::optional<uint32_t>(late_address) : std::nullopt});
+        }
+        else
+        {
+            enqueueRequests(brs, cycle, i);
+            if (late)
+                promotePrefetch(i, late_address);
+        }
+
+        // Count cycle as execution only if the instruction completed this cycle
+        if (completed)
+        {
+            caches[i].recordInstruction(ref.is_write); // record read/write instruction
+            if (sharing)
+                sharing->access(i, ref.address, ref.is_write);
+            caches[i].addExecutionCycle(1);
+            advanceTrace(i);
+        }
+        else
+        {
+            caches[i].addIdleCycle(1);
+        }
+    }
+    else if (caches[i].hasOutstandingMisses())
+    {
+        // Trace finished, but misses still in flight keep the core running
+        caches[i].waitForMisses(cycle);
+        caches[i].addIdleCycle(1);
+    }
+    else if (draining && !traces[i].atEnd())
+    {
+        caches[i].addIdleCycle(1); // Sampling: next reference waits for the bus to drain
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+void CacheSimulator::enqueueRequests(std::vector<BusRequest> &brs, int cycle, int core)
+{
+    if (brs.empty())
+        return;
+
+    for (auto &r : brs)
+    {
+        // Set the correct duration based on the operation
+        if (r.operation == BusOperation::BUS_UPGR)
+        {
+            r.duration = 1; // Invalidation signal is fast
+        }
+        else if (isVictimTransfer(r.operation))
+        {
+            r.duration = MEMORY_LATENCY; // Writeback to memory
+        }
+        else
+        {
+            r.duration = MEMORY_LATENCY; // Default for memory access
+        }
+
+        r.start_cycle = cycle;
+        bus_queue.push(r);
+    }
+
+    if (debug)
+    {
+        std::cout << "[CYCLE " << std::setw(6) << cycle << "] "
+                  << "Core " << core << " added requests to queue:" << std::endl;
+        printBusQueue(bus_queue);
+    }
+}
+
+namespace
+{
+    const char *const CHECKPOINT_MAGIC = "L1simulate checkpoint";
+    const uint32_t CHECKPOINT_VERSION = 4;
+}
+
+void CacheSimulator::setCheckpoint(const std::string &path, long long at_cycle, long long at_refs)
+{
+    checkpoint_path = path;
+    checkpoint_cycle = at_cycle;
+    checkpoint_refs = at_refs;
+}
+
+std::string CacheSimulator::checkpointConfig() const
+{
+    std::ostringstream config;
+    config << "trace " << trace_prefix << ", cores " << num_cores << ", s " << s_bits << ", E " << E_assoc
+           << ", b " << b_bits << ", " << protocol->name << ", " << replacement_name
+           << ", split bus " << split_bus_slots << ", MSHRs " << mshrs_per_cache
+           << ", write buffer " << write_buffer_depth << ", snoop filter " << (snoop_filter ? "on" : "off");
+    if (!prefetcher_name.empty())
+        config << ", prefetcher " << prefetcher_name << " " << prefetch_degree;
+    if (l2)
+    {
+        config << ", L2 " << l2->sizeBytes() << " B " << l2->getAssociativity() << "-way "
+               << (1 << l2->getBlockBits()) << " B blocks " << l2->policyName() << " inclusion "
+               << static_cast<int>(inclusion) << " latency " << l2_latency;
+    }
+    return config.str();
+}
+
+bool CacheSimulator::saveCheckpoint(int cycle, const std::vector<bool> &done) const
+{
+    std::ofstream file(checkpoint_path, std::ios::binary);
+    CheckpointWriter out(file);
+    out.put(std::string(CHECKPOINT_MAGIC));
+    out.put(CHECKPOINT_VERSION);
+    out.put(checkpointConfig());
+
+    out.put(cycle);
+    out.put(std::vector<uint8_t>(done.begin(), done.end()));
+    std::vector<uint64_t> positions;
+    for (const TraceStream &trace : traces)
+        positions.push_back(trace.position());
+    out.put(positions);
+    out.put(compute_left);
+
+    for (const L1Cache &cache : caches)
+        cache.saveState(out);
+    if (l2)
+        l2->saveState(out);
+    if (snoop_filter)
+        snoop_filter->saveState(out);
+
+    out.put(bus_queue.heap());
+    out.put(bus_busy);
+    out.put(bus_free_cycle);
+    out.put(current_bus);
+    out.put(current_data_from_cache);
+    out.put(current_new_state);
+    out.put(in_flight);
+    out.put(current_phase);
+    out.put(current_txn);
+    out.put(peak_in_flight);
+    out.put(bus_busy_cycles);
+    out.put(bus_stats);
+    out.put(core_bus_stats);
+
+    file.flush();
+    if (!out.ok())
+    {
+        std::cerr << "Error: Could not write checkpoint file: '" << checkpoint_path << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CacheSimulator::restoreCheckpoint(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "Error: Could not open checkpoint file: '" << path << "'" << std::endl;
+        return false;
+    }
+    CheckpointReader in(file);
+    std::string magic, config;
+    uint32_t version = 0;
+    in.get(magic);
+    in.get(version);
+    if (!in.ok() || magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION)
+    {
+        std::cerr << "Error: '" << path << "' is not a checkpoint of this simulator version" << std::endl;
+        return false;
+    }
+    in.get(config);
+    if (config != checkpointConfig())
+    {
+        std::cerr << "Error: Checkpoint was taken with a different configuration\n"
+                  << "  checkpoint: " << config << "\n  this run:   " << checkpointConfig() << std::endl;
+        return false;
+    }
+
+    std::vector<uint64_t> positions;
+    in.get(resume_cycle);
+    in.get(resume_done);
+    in.get(positions);
+    in.get(compute_left);
+    if (!in.ok() || resume_done.size() != caches.size() || positions.size() != traces.size() ||
+        compute_left.size() != traces.size())
+    {
+        std::cerr << "Error: Checkpoint file is truncated: '" << path << "'" << std::endl;
+        return false;
+    }
+
+    for (L1Cache &cache : caches)
+        cache.loadState(in);
+    if (l2)
+        l2->loadState(in);
+    if (snoop_filter)
+        snoop_filter->loadState(in);
+
+    in.get(bus_queue.heap());
+    in.get(bus_busy);
+    in.get(bus_free_cycle);
+    in.get(current_bus);
+    in.get(current_data_from_cache);
+    in.get(current_new_state);
+    in.get(in_flight);
+    in.get(current_phase);
+    in.get(current_txn);
+    in.get(peak_in_flight);
+    in.get(bus_busy_cycles);
+    in.get(bus_stats);
+    in.get(core_bus_stats, static_cast<size_t>(num_cores));
+
+    // Requests index the caches by core id
+    auto valid_request = [this](const BusRequest &req)
+    {
+        return req.core_id >= 0 && req.core_id < num_cores &&
+               req.operation >= BusOperation::BUS_RD && req.operation <= BusOperation::EVICT_CLEAN;
+    };
+    bool requests_valid = !current_bus || valid_request(*current_bus);
+    for (const BusRequest &req : bus_queue.heap())
+        requests_valid = requests_valid && valid_request(req);
+    for (const SplitTransaction &txn : in_flight)
+        requests_valid = requests_valid && valid_request(txn.request);
+    if (!requests_valid)
+        in.fail();
+    if (!in.ok())
+    {
+        std::cerr << "Error: Checkpoint file is truncated or corrupt: '" << path << "'" << std::endl;
+        return false;
+    }
+
+    for (int i = 0; i < num_cores; ++i)
+    {
+        if (!traces[i].seek(positions[i]))
+        {
+            std::cerr << "Error: Trace for core " << i << " is shorter than the checkpoint" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void CacheSimulator::stepCycle(int &cycle, std::vector<bool> &done, int &remaining)
 {
-    if (queue.empty())
+    if (debug)
     {
-        std::cout << "    Queue: [empty]" << std::endl;
-        return;
+        std::cout << "\n[CYCLE " << std::setw(6) << cycle << "] "
+                  << "Remaining cores: " << remaining
+                  << " | Queue size: " << bus_queue.size()
+                  << " | Bus busy: " << (bus_busy ? "YES" : "NO") << std::endl;
+        printBusQueue(bus_queue); // Print bus queue contents
     }
 
-    std::cout << "    Queue: [";
+    if (write_buffer_depth > 0)
+        drainWriteBuffers(cycle);
+    if (split_bus_slots > 0)
+        stepSplitBus(cycle);
+    else
+        stepAtomicBus(cycle);
 
-    while (!queue.empty())
+    stepCores(cycle, done, remaining);
+    ++cycle;
+
+    // Next-event time advance: with every active core stalled or inside a trace
+    // gap, nothing can change before the bus's next event or the end of the
+    // shortest gap, so jump straight there and credit the skipped cycles in bulk
+    if (cycle_skipping && remaining > 0)
     {
-        const BusRequest &br = queue.top();
-        std::cout << "Core" << br.core_id << ":"
-                  << busOpToString(br.operation)
-                  << ":0x" << std::hex << br.address << std::dec;
+        int next_event = nextBusEvent(cycle);
+        bool all_waiting = next_event > cycle;
+        bool computing = false;
+        for (int i = 0; all_waiting && i < num_cores; ++i)
+        {
+            if (done[i] || caches[i].isBlocked())
+                continue;
+            if (compute_left[i] > 0 && !draining)
+            {
+                next_event = std::min(next_event, cycle + compute_left[i]);
+                computing = true;
+            }
+            else
+            {
+                all_waiting = false;
+            }
+        }
 
-        queue.pop();
-        if (!queue.empty())
+        if (all_waiting && next_event != std::numeric_limits<int>::max())
         {
-            std::cout << ", ";
+            int skipped = next_event - cycle;
+            if (debug)
+            {
+                std::cout << "[CYCLE " << std::setw(6) << cycle << "] "
+                          << (computing ? "All cores stalled or computing" : "All cores stalled")
+                          << ", skipping " << skipped << " cycles" << std::endl;
+            }
+            for (int i = 0; i < num_cores; ++i)
+            {
+                if (done[i])
+                    continue;
+                if (caches[i].isBlocked())
+                    caches[i].addIdleCycle(skipped);
+                else
+                    compute(i, skipped);
+            }
+            cycle = next_event;
         }
     }
-    std::cout << "]" << std::endl;
 }
 
-CacheSimulator::CacheSimulator(int s, int E, int b)
-    : s_bits(s), E_assoc(E), b_bits(b)
+long long CacheSimulator::completedRefs() const
 {
-    for (int i = 0; i < num_cores; ++i)
+    long long refs = 0;
+    for (const TraceStream &trace : traces)
+        refs += trace.position();
+    return refs;
+}
+
+void CacheSimulator::advanceTrace(int core)
+{
+    traces[core].advance();
+    compute_left[core] = traces[core].atEnd() ? 0 : traces[core].peek().gap;
+}
+
+void CacheSimulator::compute(int core, int cycles)
+{
+    compute_left[core] -= cycles;
+    caches[core].addComputeCycles(cycles);
+}
+
+void CacheSimulator::functionalAccess(int core, int cycle)
+{
+    // The access's bus transactions are begun and applied on the spot, so the
+    // snoops, the L2 and the bus statistics follow the detailed engine
+    const MemRef &ref = traces[core].peek();
+    BusOperation op;
+    std::optional<BusOperation> eviction;
+    uint32_t victim_address = 0;
+    if (caches[core].warmAccess(ref, op, eviction, victim_address))
     {
-        caches.emplace_back(i, s_bits, b_bits, E_assoc);
+        bool data_from_cache;
+        MESIState new_state;
+        int duration;
+        if (eviction)
+            beginTransaction(BusRequest(core, *eviction, victim_address, cycle, 0), cycle, data_from_cache,
+                             new_state, duration);
+        beginTransaction(BusRequest(core, op, ref.address, cycle, 0), cycle, data_from_cache, new_state, duration);
+        caches[core].warmFill(ref, op, new_state);
     }
-    trace_position.resize(num_cores, 0);
-    core_bus_stats.resize(num_cores); // Initialize per-core bus stats
+    caches[core].recordInstruction(ref.is_write);
+    if (sharing)
+        sharing->access(core, ref.address, ref.is_write);
+    advanceTrace(core);
 }
 
-bool CacheSimulator::loadTraces(const std::string &app_name)
+void CacheSimulator::runFunctional(int &cycle, std::vector<bool> &done, int &remaining)
 {
-    // For output display, extract just the base name
-    size_t lastSlash = app_name.rfind('/');
-    if (lastSlash != std::string::npos)
+    // Round-robin: each core with references left completes one per cycle
+    while (remaining > 0)
     {
-        trace_prefix = app_name.substr(lastSlash + 1);
+        bool active = false;
+        for (int i = 0; i < num_cores; ++i)
+        {
+            if (done[i])
+                continue;
+            if (traces[i].atEnd())
+            {
+                done[i] = true;
+                --remaining;
+                continue;
+            }
+            functionalAccess(i, cycle);
+            caches[i].addExecutionCycle(1);
+            active = true;
+        }
+        if (active)
+            ++cycle;
     }
-    else
+}
+
+bool CacheSimulator::quiescent() const
+{
+    if (bus_busy || !bus_queue.empty() || !in_flight.empty())
+        return false;
+    for (const L1Cache &cache : caches)
     {
-        trace_prefix = app_name;
+        if (cache.isBlocked() || cache.hasOutstandingMisses() || cache.hasBufferedWriteback())
+            return false;
     }
+    return true;
+}
 
-    trace_data.resize(num_cores);
+void CacheSimulator::warmFunctionally(long long count, int cycle, SamplePeriod &period)
+{
+    // Weights from the last window keep the cores' relative progress, so a core
+    // that loses arbitration stays behind as it would in a detailed run
+    std::vector<double> weight(num_cores, 1.0);
+    if (!samples.empty())
+    {
+        for (int i = 0; i < num_cores; ++i)
+            weight[i] = static_cast<double>(samples.back().refs[i]);
+    }
 
+    // Stride scheduling: the eligible core with the smallest pass goes next
+    std::vector<double> pass(num_cores, 0.0);
+    period.active_refs.assign(num_cores, -1);
     for (int i = 0; i < num_cores; ++i)
     {
-        // Construct trace filename - ensure proper path handling
-        std::string filename = app_name + "_proc" + std::to_string(i) + ".trace";
+        if (traces[i].atEnd())
+            period.active_refs[i] = 0;
+    }
+    long long warmed = 0;
+    while (warmed < count)
+    {
+        int next = -1;
+        for (int pass_zero_weights = 0; pass_zero_weights < 2 && next < 0; ++pass_zero_weights)
+        {
+            // Cores that made no progress only run once the others have finished
+            for (int i = 0; i < num_cores; ++i)
+            {
+                bool eligible = period.active_refs[i] < 0 && (weight[i] > 0 || pass_zero_weights);
+                if (eligible && (next < 0 || pass[i] < pass[next]))
+                    next = i;
+            }
+        }
+        if (next < 0)
+            break;
+
+        functionalAccess(next, cycle);
+        ++warmed;
+        pass[next] += weight[next] > 0 ? 1.0 / weight[next] : 1.0;
+        if (traces[next].atEnd())
+            period.active_refs[next] = warmed;
+    }
+
+    period.functional_refs = warmed;
+    for (long long &active : period.active_refs)
+    {
+        if (active < 0)
+            active = warmed;
+    }
+}
+
+void CacheSimulator::runSampled(int &cycle, std::vector<bool> &done, int &remaining)
+{
+    samples.clear();
+    long long functional_per_period = sample_period - sample_warmup - sample_window;
+    while (remaining > 0)
+    {
+        SamplePeriod period;
+        auto functional_start = std::chrono::steady_clock::now();
+        warmFunctionally(functional_per_period, cycle, period);
+        functional_refs += period.functional_refs;
+        functional_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - functional_start).count();
 
-        std::ifstream file(filename);
-        if (!file.is_open())
+        // Detailed warm-up, then the measured window
+        std::vector<CoreStats> start, before;
+        for (const L1Cache &cache : caches)
+            start.push_back(cache.getStats());
+        long long target = completedRefs() + sample_warmup;
+        while (remaining > 0 && completedRefs() < target)
+            stepCycle(cycle, done, remaining);
+
+        std::vector<size_t> before_refs;
+        for (int i = 0; i < num_cores; ++i)
         {
-            std::cerr << "Error: Could not open trace file: '" << filename << "'" << std::endl;
-            return false;
+            before.push_back(caches[i].getStats());
+            before_refs.push_back(traces[i].position());
         }
+        int window_start = cycle;
+        long long window_start_refs = completedRefs();
+        target = window_start_refs + sample_window;
+        while (remaining > 0 && completedRefs() < target)
+            stepCycle(cycle, done, remaining);
 
-        std::string line;
-        while (std::getline(file, line))
+        period.window_refs = completedRefs() - window_start_refs;
+        period.window_cycles = cycle - window_start;
+        for (int i = 0; i < num_cores; ++i)
         {
-            if (line.empty())
-                continue;
-            std::istringstream iss(line);
-            char op;
-            std::string addr_str;
-            if (!(iss >> op >> addr_str))
-                continue;
-            uint32_t address = (addr_str.rfind("0x", 0) == 0)
-                                   ? std::stoul(addr_str, nullptr, 16)
-                                   : std::stoul(addr_str, nullptr, 10);
-            trace_data[i].push_back({op == 'W', address});
+            CoreStats after = caches[i].getStats();
+            period.detailed_cycles.push_back((after.execution_cycles + after.idle_cycles) -
+                                             (start[i].execution_cycles + start[i].idle_cycles));
+            period.refs.push_back(static_cast<long long>(traces[i].position() - before_refs[i]));
+            period.misses.push_back(after.cache_misses - before[i].cache_misses);
         }
+        samples.push_back(std::move(period));
+
+        // Let outstanding requests finish so the next functional phase starts
+        // from a quiet bus; these cycles are not counted
+        draining = true;
+        while (remaining > 0 && !quiescent())
+            stepCycle(cycle, done, remaining);
+        draining = false;
     }
-    return true;
 }
 
-void CacheSimulator::runSimulation()
+namespace
 {
-    int remaining = num_cores;
-    std::vector<bool> done(num_cores, false);
-    int cycle = 0;
-
-    // std::cout << "===== SIMULATION START =====" << std::endl;
+    // Epochs shorter than this are left to the serial loop, which is cheaper
+    // than waking the workers for them
+    const int MIN_EPOCH = 4;
+    // Most accesses a core looks ahead for local hits while the bus is idle
+    const int LOOKAHEAD = 1024;
 
-    while (remaining > 0)
+    // Runs a job for every core on a fixed set of threads, the calling thread
+    // included: core i runs on thread i % threads. Epochs last microseconds, so
+    // idle workers spin, then yield, rather than sleep.
+    class EpochPool
     {
-        if (DEBUG_MODE)
+    public:
+        EpochPool(int threads, int cores) : threads(threads), cores(cores)
         {
-            std::cout << "\n[CYCLE " << std::setw(6) << cycle << "] "
-                      << "Remaining cores: " << remaining
-                      << " | Queue size: " << bus_queue.size()
-                      << " | Bus busy: " << (bus_busy ? "YES" : "NO") << std::endl;
-            printBusQueue(bus_queue); // Print bus queue contents
+            for (int t = 1; t < threads; ++t)
+                workers.emplace_back([this, t] { work(t); });
         }
 
-        // Start next bus transaction if bus is free
-        if (!bus_busy && !bus_queue.empty())
+        ~EpochPool()
         {
-            // Arbitration: pick the request from the lowest core ID (priority_queue)
-            BusRequest br = bus_queue.top();
-            bus_queue.pop();
+            stop = true;
+            generation.fetch_add(1, std::memory_order_release);
+            for (auto &worker : workers)
+                worker.join();
+        }
 
-            if (DEBUG_MODE)
-            {
-                std::cout << "[CYCLE " << std::setw(6) << cycle << "] "
-                          << "Arbitration: Selected core " << br.core_id << " bus request" << std::endl;
-            }
-            current_bus = br;
+        void run(const std::function<void(int)> &task)
+        {
+            job = &task;
+            pending.store(threads - 1, std::memory_order_relaxed);
+            generation.fetch_add(1, std::memory_order_release);
+            share(0);
+            int spins = 0;
+            while (pending.load(std::memory_order_acquire) > 0)
+                pause(spins);
+        }
 
-            // Count this transaction
-            bus_stats.transactions++;
-            core_bus_stats[br.core_id].transactions++;
+    private:
+        static constexpr int SPINS = 4096;
+        int threads, cores;
+        std::vector<std::thread> workers;
+        const std::function<void(int)> *job = nullptr;
+        bool stop = false;                  // Published by generation
+        std::atomic<unsigned> generation{0}; // One step per epoch
+        std::atomic<int> pending{0};         // Workers still busy with this epoch
 
-            if (DEBUG_MODE)
+        void share(int t)
+        {
+            for (int i = t; i < cores; i += threads)
+                (*job)(i);
+        }
+
+        void work(int t)
+        {
+            unsigned seen = 0;
+            while (true)
             {
-                std::cout << "[CYCLE " << std::setw(6) << cycle << "] "
-                          << "BUS: Core " << br.core_id << " starts "
-                          << busOpToString(br.operation)
-                          << " for address 0x" << std::hex << br.address << std::dec << std::endl;
+                int spins = 0;
+                unsigned now;
+                while ((now = generation.load(std::memory_order_acquire)) == seen)
+                    pause(spins);
+                seen = now;
+                if (stop)
+                    return;
+                share(t);
+                pending.fetch_sub(1, std::memory_order_release);
             }
+        }
 
-            // Snooping - process properly based on the bus operation
-            bool data_from_cache = false;
-            int transfer_cycles = 0;
+        static void pause(int &spins)
+        {
+            if (++spins > SPINS)
+                std::this_thread::yield();
+        }
+    };
+}
 
-            // Updated based on clarification #21: Read miss allows cache-to-cache transfer, write miss always from memory
-            if (br.operation == BusOperation::BUS_RD)
-            {
-                // For read miss, check other caches for the data (cache-to-cache transfer allowed)
-                for (int i = 0; i < num_cores; ++i)
-                {
-                    if (i == br.core_id)
-                        continue;
-
-                    bool can_provide_data = false;
-                    int this_transfer_cycles = 0;
-                    caches[i].handleBusRequest(br, cycle, can_provide_data, this_transfer_cycles);
-
-                    if (can_provide_data && !data_from_cache)
-                    {
-                        data_from_cache = true;
-                        transfer_cycles = this_transfer_cycles;
-                    }
-                }
-
-                // Read miss, set appropriate state
-                current_new_state = data_from_cache ? MESIState::SHARED : MESIState::EXCLUSIVE;
-            }
-            else if (br.operation == BusOperation::BUS_RDX)
-            {
-                // For write miss, always fetch from memory per clarification #21
-                // But still need to invalidate in other caches
-                for (int i = 0; i < num_cores; ++i)
-                {
-                    if (i == br.core_id)
-                        continue;
-
-                    bool can_provide_data = false;
-                    int this_transfer_cycles = 0;
-                    caches[i].handleBusRequest(br, cycle, can_provide_data, this_transfer_cycles);
-
-                    // Even if another cache has the data, we don't use it for BUS_RDX
-                    // Data always comes from memory for write miss
-                }
-
-                // Always set to MODIFIED for write miss
-                current_new_state = MESIState::MODIFIED;
-                data_from_cache = false; // Force memory access for write miss
-            }
-            else if (br.operation == BusOperation::BUS_UPGR)
-            {
-                // Invalidate in other caches
-                for (int i = 0; i < num_cores; ++i)
-                {
-                    if (i == br.core_id)
-                        continue;
-
-                    bool dummy = false;
-                    int dummy2 = 0;
-                    caches[i].handleBusRequest(br, cycle, dummy, dummy2);
-                }
-                current_new_state = MESIState::MODIFIED;
-            }
+int CacheSimulator::localHits(int core, int limit)
+{
+    L1Cache &cache = caches[core];
+    TraceStream &trace = traces[core];
+    if (cache.isBlocked())
+        return limit; // Stays blocked until the bus acts
+    if (trace.atEnd())
+        return 0; // Finishing, or waiting for misses, is left to the serial loop
 
-            // Update data source flag
-            current_data_from_cache = data_from_cache;
+    // Cycles until each buffered reference issues: the gap left now, then one
+    // cycle per access plus the following reference's gap. Past the buffer the
+    // next reference issues a cycle after the last one, at the earliest.
+    long long issue = compute_left[core];
+    size_t count = trace.buffered();
+    for (size_t k = 0; k < count && issue < limit; ++k)
+    {
+        if (!cache.hitsLocally(trace.peek(k)))
+            return static_cast<int>(issue);
+        issue += 1 + (k + 1 < count ? trace.peek(k + 1).gap : 0);
+    }
+    return static_cast<int>(std::min<long long>(issue, limit));
+}
 
-            // Calculate bus transaction duration
-            int duration;
-            if (br.operation == BusOperation::FLUSH || br.operation == BusOperation::FLUSH_OPT)
-            {
-                duration = 100; // Writeback to memory
-            }
-            else if (br.operation == BusOperation::BUS_RD)
-            {
-                // For read miss, use cache-to-cache if available
-                if (data_from_cache)
-                {
-                    duration = transfer_cycles; // Cache-to-cache transfer (typically 2*N cycles)
-                }
-                else
-                {
-                    duration = 100; // Memory access
-                }
-            }
-            else if (br.operation == BusOperation::BUS_RDX)
-            {
-                // For write miss, always use memory
-                duration = 100; // Memory access
-            }
-            else // BUS_UPGR
-            {
-                duration = 1; // Just invalidation signals
-            }
+void CacheSimulator::runParallel(int &cycle, std::vector<bool> &done, int &remaining)
+{
+    // Conservative synchronization: every bus transaction snoops the caches when
+    // it is granted, and a grant needs the bus to be free. While it is busy, the
+    // cores cannot affect each other before its next event, and run freely up to
+    // it. While it is idle, a request made in one cycle is granted in the next,
+    // so the epoch stops short of the first access that is not a local hit.
+    const int never = std::numeric_limits<int>::max();
+    // Spinning workers only pay off with a hardware thread each
+    int hardware = std::max(1u, std::thread::hardware_concurrency());
+    parallel_workers = std::min({parallel_threads, num_cores, hardware});
+    EpochPool pool(parallel_workers, num_cores);
+    std::vector<std::vector<EpochEvent>> logs(num_cores);
+    std::vector<int> hits(num_cores);
+    std::vector<int> finished(num_cores); // Cycle a core finished in the epoch, or -1
 
-            // Update bus stats
-            if (br.operation == BusOperation::BUS_UPGR || br.operation == BusOperation::BUS_RDX)
+    int until = 0;
+    std::function<void(int)> lookahead = [&](int i)
+    {
+        hits[i] = done[i] ? until - cycle : localHits(i, until - cycle);
+    };
+    std::function<void(int)> epoch = [&](int i)
+    {
+        finished[i] = -1;
+        if (done[i])
+            return;
+        for (int c = cycle; c < until; ++c)
+        {
+            if (caches[i].isBlocked())
             {
-                bus_stats.invalidations++;
-                core_bus_stats[br.core_id].invalidations++;
+                caches[i].addIdleCycle(until - c);
+                break;
             }
-
-            // Update data traffic stats
-            if (br.operation == BusOperation::BUS_RD && data_from_cache)
+            if (compute_left[i] > 0)
             {
-                // For cache-to-cache transfers on read miss
-                int blockSize = caches[br.core_id].getBlockSize();
-                bus_stats.data_traffic_bytes += blockSize;
-                core_bus_stats[br.core_id].data_traffic_bytes += blockSize;
+                int cycles = std::min(compute_left[i], until - c);
+                compute(i, cycles);
+                c += cycles - 1;
+                continue;
             }
-            else if (br.operation == BusOperation::BUS_RD || br.operation == BusOperation::BUS_RDX ||
-                     br.operation == BusOperation::FLUSH || br.operation == BusOperation::FLUSH_OPT)
+            if (!stepCore(i, c, &logs[i]))
             {
-                // For memory transfers, count full block size
-                int blockSize = caches[br.core_id].getBlockSize();
-                bus_stats.data_traffic_bytes += blockSize;
-                core_bus_stats[br.core_id].data_traffic_bytes += blockSize;
+                finished[i] = c;
+                break;
             }
-
-            bus_busy = true;
-            bus_free_cycle = cycle + duration;
         }
+    };
 
-        // Complete bus transaction
-        if (bus_busy && cycle == bus_free_cycle)
+    while (remaining > 0)
+    {
+        until = nextBusEvent(cycle);
+        if (!bus_busy)
         {
-            if (current_bus.has_value())
+            until = cycle + (until == never ? LOOKAHEAD : std::min(until - cycle, LOOKAHEAD));
+            if (until - cycle >= MIN_EPOCH)
             {
-                BusRequest br = current_bus.value();
-                auto &cache = caches[br.core_id];
-
-                if (br.operation == BusOperation::BUS_UPGR)
-                {
-                    cache.completeMemoryRequest(cycle, true, false, current_new_state);
-                }
-                else if (br.operation == BusOperation::BUS_RD || br.operation == BusOperation::BUS_RDX)
-                {
-                    cache.completeMemoryRequest(cycle, false, current_data_from_cache, current_new_state);
-                }
-                else if (br.operation == BusOperation::FLUSH || br.operation == BusOperation::FLUSH_OPT)
-                {
-                    cache.unblock(cycle);
-                }
+                pool.run(lookahead);
+                until = cycle + *std::min_element(hits.begin(), hits.end());
             }
+        }
+        if (until - cycle < MIN_EPOCH)
+        {
+            stepCycle(cycle, done, remaining);
+            continue;
+        }
 
-            bus_busy = false;
-            current_bus = std::nullopt; // Use std::nullopt instead of reset() to avoid potential issues
+        if (snoop_filter)
+            snoop_filter->deferUpdates(num_cores);
+        pool.run(epoch);
+        if (snoop_filter)
+            snoop_filter->applyDeferred();
+
+        // Bus work in the order the serial loop would have queued it: by cycle,
+        // then by core
+        std::vector<EpochEvent> events;
+        for (auto &log : logs)
+        {
+            std::move(log.begin(), log.end(), std::back_inserter(events));
+            log.clear();
+        }
+        std::sort(events.begin(), events.end(), [](const EpochEvent &a, const EpochEvent &b)
+                  { return a.cycle != b.cycle ? a.cycle < b.cycle : a.core < b.core; });
+        for (EpochEvent &event : events)
+        {
+            enqueueRequests(event.requests, event.cycle, event.core);
+            if (event.late_prefetch)
+                promotePrefetch(event.core, *event.late_prefetch);
         }
 
-        // Process each core
+        int last_finished = -1;
         for (int i = 0; i < num_cores; ++i)
         {
-            if (done[i])
+            if (finished[i] < 0)
                 continue;
+            done[i] = true;
+            --remaining;
+            last_finished = std::max(last_finished, finished[i]);
+        }
+        int end = remaining > 0 ? until : last_finished + 1;
+        parallel_epochs++;
+        parallel_cycles += end - cycle;
+        cycle = end;
+    }
+}
 
-            if (!caches[i].isBlocked())
-            {
-                if (trace_position[i] < trace_data[i].size())
-                {
-                    const MemRef &ref = trace_data[i][trace_position[i]];
-                    std::vector<BusRequest> brs;
-                    bool completed = caches[i].processMemoryRequest(ref, cycle, brs);
-
-                    // Enqueue bus requests from this cycle
-                    if (!brs.empty())
-                    {
-                        for (auto &r : brs)
-                        {
-                            // Set the correct duration based on the operation
-                            if (r.operation == BusOperation::BUS_UPGR)
-                            {
-                                r.duration = 1; // Invalidation signal is fast
-                            }
-                            else if (r.operation == BusOperation::FLUSH || r.operation == BusOperation::FLUSH_OPT)
-                            {
-                                r.duration = 100; // Writeback to memory
-                            }
-                            else
-                            {
-                                r.duration = 100; // Default for memory access
-                            }
-
-                            r.start_cycle = cycle;
-                            bus_queue.push(r);
-                        }
-
-                        if (DEBUG_MODE)
-                        {
-                            std::cout << "[CYCLE " << std::setw(6) << cycle << "] "
-                                      << "Core " << i << " added requests to queue:" << std::endl;
-                            printBusQueue(bus_queue);
-                        }
-                    }
-
-                    // Count cycle as execution only if the instruction completed this cycle
-                    if (completed)
-                    {
-                        caches[i].recordInstruction(ref.is_write); // record read/write instruction
-                        caches[i].addExecutionCycle(1);
-                        trace_position[i]++;
-                    }
-                    else
-                    {
-                        caches[i].addIdleCycle(1);
-                    }
-                }
-                else
-                {
-                    done[i] = true;
-                    --remaining;
-                }
-            }
-            else
+void CacheSimulator::runSimulation()
+{
+    auto sim_start = std::chrono::steady_clock::now();
+    std::vector<bool> done(num_cores, false);
+    if (!resume_done.empty())
+        done.assign(resume_done.begin(), resume_done.end());
+    int remaining = static_cast<int>(std::count(done.begin(), done.end(), false));
+    int cycle = resume_cycle;
+    bool checkpoint_pending = !checkpoint_path.empty();
+    if (compute_left.empty())
+    {
+        // Gap ahead of each core's first reference (a checkpoint restores its own)
+        for (TraceStream &trace : traces)
+            compute_left.push_back(trace.atEnd() ? 0 : trace.peek().gap);
+    }
+
+    // std::cout << "===== SIMULATION START =====" << std::endl;
+
+    if (sample_period > 0)
+        runSampled(cycle, done, remaining);
+    if (parallel_threads > 0)
+        runParallel(cycle, done, remaining);
+    if (functional)
+        runFunctional(cycle, done, remaining);
+    while (remaining > 0)
+    {
+        // Taken between cycles, where the whole state lives in the members
+        if (checkpoint_pending)
+        {
+            long long refs = completedRefs();
+            if ((checkpoint_cycle >= 0 && cycle >= checkpoint_cycle) ||
+                (checkpoint_refs >= 0 && refs >= checkpoint_refs))
             {
-                caches[i].addIdleCycle(1); // Core is stalled waiting for cache miss or bus access
+                if (saveCheckpoint(cycle, done))
+                    std::cerr << "Checkpoint written to " << checkpoint_path << " at cycle " << cycle
+                              << " (" << refs << " references)" << std::endl;
+                checkpoint_pending = false;
             }
         }
-        ++cycle;
+
+        stepCycle(cycle, done, remaining);
+    }
+
+    if (checkpoint_pending)
+        std::cerr << "Warning: Simulation finished before the checkpoint was reached" << std::endl;
+    total_cycles = cycle;
+    simulation_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - sim_start).count();
+    for (int i = 0; i < num_cores; ++i)
+    {
+        if (traces[i].hasFailed())
+            std::cerr << "Warning: Trace for core " << i << " is truncated or malformed" << std::endl;
+    }
+    if (l2 && inclusion == InclusionPolicy::INCLUSIVE)
+    {
+        long long missing = countInclusionViolations();
+        if (missing > 0)
+            std::cerr << "Warning: " << missing << " L1 blocks are missing from the inclusive L2" << std::endl;
     }
 }
 
@@ -388,11 +1963,40 @@ void CacheSimulator::printResults(std::ofstream &outfile)
     std::cout << "Block Size (Bytes): " << block_size << std::endl;
     std::cout << "Number of Sets: " << num_sets << std::endl;
     std::cout << "Cache Size (KB per core): " << cache_size_kb << std::endl;
-    std::cout << "MESI Protocol: Enabled" << std::endl;
+    std::cout << protocol->name << " Protocol: Enabled" << std::endl;
     std::cout << "Write Policy: Write-back, Write-allocate" << std::endl;
-    std::cout << "Replacement Policy: LRU" << std::endl;
-    std::cout << "Bus: Central snooping bus" << std::endl
-              << std::endl;
+    std::cout << "Replacement Policy: " << replacement_name << std::endl;
+    std::cout << "Bus: Central snooping bus" << (snoop_filter ? " with snoop filter" : "");
+    if (split_bus_slots > 0)
+        std::cout << ", split-transaction (" << split_bus_slots << " outstanding)";
+    std::cout << std::endl;
+    if (mshrs_per_cache > 0)
+        std::cout << "Caches: Non-blocking, " << mshrs_per_cache << " MSHRs per core" << std::endl;
+    if (write_buffer_depth > 0)
+        std::cout << "Write Buffer: " << write_buffer_depth << " entries per core" << std::endl;
+    if (!prefetcher_name.empty())
+        std::cout << "Prefetcher: " << prefetcher_name << " (degree " << prefetch_degree << ")" << std::endl;
+    if (l2)
+    {
+        static const char *const inclusion_names[] = {"inclusive", "exclusive", "NINE"};
+        std::cout << "L2 Cache: " << l2->sizeBytes() / 1024 << " KB shared, " << l2->getAssociativity()
+                  << "-way, " << (1 << l2->getBlockBits()) << " B blocks, " << l2->policyName() << ", "
+                  << inclusion_names[static_cast<int>(inclusion)] << ", " << l2_latency << "-cycle hits" << std::endl;
+    }
+    if (functional)
+        std::cout << "Timing: None (functional mode, cores take turns completing one reference per cycle)" << std::endl;
+    if (sample_period > 0)
+    {
+        std::cout << "Sampling: every " << sample_period << " references, " << sample_warmup
+                  << " detailed warm-up and " << sample_window << " measured" << std::endl;
+    }
+    std::cout << std::endl;
+
+    if (sample_period > 0)
+    {
+        printSampling(outfile);
+        return;
+    }
 
     // Print per-core statistics
     for (int i = 0; i < num_cores; ++i)
@@ -400,9 +2004,9 @@ void CacheSimulator::printResults(std::ofstream &outfile)
         auto stats = caches[i].getStats();
         auto bus_stats_core = core_bus_stats[i];
 
-        int total_instructions = stats.instruction_count;
+        long long total_instructions = stats.instruction_count;
         double miss_rate = (total_instructions > 0) ? (100.0 * stats.cache_misses / total_instructions) : 0.0;
-        int total_cycles = stats.execution_cycles + stats.idle_cycles; // Include idle cycles in total
+        long long total_cycles = stats.execution_cycles + stats.idle_cycles; // Include idle cycles in total
 
         std::cout << "Core " << i << " Statistics:" << std::endl;
         std::cout << "Total Instructions: " << total_instructions << std::endl;
@@ -411,13 +2015,64 @@ void CacheSimulator::printResults(std::ofstream &outfile)
         std::cout << "Total Execution Cycles: " << total_cycles << std::endl;
         // std::cout << "Active Cycles: " << stats.execution_cycles << std::endl;
         std::cout << "Idle Cycles: " << stats.idle_cycles << std::endl;
+        if (stats.compute_cycles > 0)
+            std::cout << "Compute Cycles: " << stats.compute_cycles << std::endl;
         std::cout << "Cache Misses: " << stats.cache_misses << std::endl;
         std::cout << "Cache Miss Rate: " << std::fixed << std::setprecision(2) << miss_rate << "%" << std::endl;
         std::cout << "Cache Evictions: " << stats.evictions << std::endl;
         std::cout << "Writebacks: " << stats.writebacks << std::endl;
         std::cout << "Bus Invalidations: " << bus_stats_core.invalidations << std::endl;
-        std::cout << "Data Traffic (Bytes): " << bus_stats_core.data_traffic_bytes << std::endl
-                  << std::endl;
+        std::cout << "Data Traffic (Bytes): " << bus_stats_core.data_traffic_bytes << std::endl;
+        double mshr_occupancy = (total_cycles > 0) ? static_cast<double>(stats.mshr_occupancy_cycles) / total_cycles : 0.0;
+        if (mshrs_per_cache > 0)
+        {
+            std::cout << "MSHR Merges: " << stats.mshr_merges << std::endl;
+            std::cout << "MSHR Full Stalls: " << stats.mshr_full_stalls << std::endl;
+            std::cout << "MSHR Average Occupancy: " << mshr_occupancy << std::endl;
+            std::cout << "MSHR Peak Occupancy: " << stats.mshr_peak << std::endl;
+        }
+        if (write_buffer_depth > 0)
+        {
+            std::cout << "Write Buffer Writebacks: " << stats.wb_buffered << std::endl;
+            std::cout << "Write Buffer Full Stalls: " << stats.wb_full_stalls << std::endl;
+            std::cout << "Write Buffer Snoop Forwards: " << stats.wb_forwards << std::endl;
+            std::cout << "Write Buffer Drain Cycles: " << stats.wb_drain_cycles << std::endl;
+        }
+
+        // Useful prefetches include late ones, which still shortened a miss
+        long long useful = stats.prefetch_hits + stats.prefetch_late;
+        long long uncovered = stats.cache_misses - stats.prefetch_late;
+        double accuracy = stats.prefetches_issued > 0 ? 100.0 * useful / stats.prefetches_issued : 0.0;
+        double coverage = useful + uncovered > 0 ? 100.0 * useful / (useful + uncovered) : 0.0;
+        double lateness = useful > 0 ? 100.0 * stats.prefetch_late / useful : 0.0;
+        if (!prefetcher_name.empty())
+        {
+            std::cout << "Prefetches Issued: " << stats.prefetches_issued << std::endl;
+            std::cout << "Prefetch Accuracy: " << accuracy << "%" << std::endl;
+            std::cout << "Prefetch Coverage: " << coverage << "%" << std::endl;
+            std::cout << "Late Prefetches: " << lateness << "%" << std::endl;
+            std::cout << "Unused Prefetches: " << stats.prefetch_unused << std::endl;
+            std::cout << "Prefetch Traffic (Bytes): " << bus_stats_core.prefetch_traffic_bytes << std::endl;
+        }
+        if (l2)
+        {
+            std::cout << "L1-L2 Traffic (Bytes): " << bus_stats_core.l2_traffic_bytes << std::endl;
+            std::cout << "Memory Traffic (Bytes): " << bus_stats_core.memory_traffic_bytes << std::endl;
+        }
+        const MissProfiler *profile = caches[i].getMissProfiler();
+        if (profile)
+        {
+            const MissCounts &classes = profile->totals();
+            std::cout << "Compulsory Misses: " << classes.compulsory << std::endl;
+            std::cout << "Capacity Misses: " << classes.capacity << std::endl;
+            std::cout << "Conflict Misses: " << classes.conflict << std::endl;
+            std::cout << "Coherence Misses: " << classes.coherence << std::endl;
+            std::cout << "Hottest Sets (set:misses):";
+            for (int set : profile->hottestSets(4))
+                std::cout << " " << set << ":" << profile->setCounts(set).misses;
+            std::cout << std::endl;
+        }
+        std::cout << std::endl;
 
         // Write to outfile if provided
         if (outfile.is_open())
@@ -428,13 +2083,52 @@ void CacheSimulator::printResults(std::ofstream &outfile)
                     << "Total Writes," << stats.write_count << "\n"
                     << "Total Execution Cycles," << total_cycles << "\n"
                     << "Active Cycles," << stats.execution_cycles << "\n"
-                    << "Idle Cycles," << stats.idle_cycles << "\n"
-                    << "Cache Misses," << stats.cache_misses << "\n"
+                    << "Idle Cycles," << stats.idle_cycles << "\n";
+            if (stats.compute_cycles > 0)
+                outfile << "Compute Cycles," << stats.compute_cycles << "\n";
+            outfile << "Cache Misses," << stats.cache_misses << "\n"
                     << "Cache Miss Rate," << miss_rate << "\n"
                     << "Cache Evictions," << stats.evictions << "\n"
                     << "Writebacks," << stats.writebacks << "\n"
                     << "Bus Invalidations," << bus_stats_core.invalidations << "\n"
-                    << "Data Traffic (Bytes)," << bus_stats_core.data_traffic_bytes << "\n\n";
+                    << "Data Traffic (Bytes)," << bus_stats_core.data_traffic_bytes << "\n";
+            if (mshrs_per_cache > 0)
+            {
+                outfile << "MSHR Merges," << stats.mshr_merges << "\n"
+                        << "MSHR Full Stalls," << stats.mshr_full_stalls << "\n"
+                        << "MSHR Average Occupancy," << mshr_occupancy << "\n"
+                        << "MSHR Peak Occupancy," << stats.mshr_peak << "\n";
+            }
+            if (write_buffer_depth > 0)
+            {
+                outfile << "Write Buffer Writebacks," << stats.wb_buffered << "\n"
+                        << "Write Buffer Full Stalls," << stats.wb_full_stalls << "\n"
+                        << "Write Buffer Snoop Forwards," << stats.wb_forwards << "\n"
+                        << "Write Buffer Drain Cycles," << stats.wb_drain_cycles << "\n";
+            }
+            if (!prefetcher_name.empty())
+            {
+                outfile << "Prefetches Issued," << stats.prefetches_issued << "\n"
+                        << "Prefetch Accuracy," << accuracy << "\n"
+                        << "Prefetch Coverage," << coverage << "\n"
+                        << "Late Prefetches," << lateness << "\n"
+                        << "Unused Prefetches," << stats.prefetch_unused << "\n"
+                        << "Prefetch Traffic (Bytes)," << bus_stats_core.prefetch_traffic_bytes << "\n";
+            }
+            if (l2)
+            {
+                outfile << "L1-L2 Traffic (Bytes)," << bus_stats_core.l2_traffic_bytes << "\n"
+                        << "Memory Traffic (Bytes)," << bus_stats_core.memory_traffic_bytes << "\n";
+            }
+            if (profile)
+            {
+                const MissCounts &classes = profile->totals();
+                outfile << "Compulsory Misses," << classes.compulsory << "\n"
+                        << "Capacity Misses," << classes.capacity << "\n"
+                        << "Conflict Misses," << classes.conflict << "\n"
+                        << "Coherence Misses," << classes.coherence << "\n";
+            }
+            outfile << "\n";
         }
     }
 
@@ -443,12 +2137,137 @@ void CacheSimulator::printResults(std::ofstream &outfile)
     std::cout << "Overall Bus Summary:" << std::endl;
     std::cout << "Total Bus Transactions: " << bus_stats.transactions << std::endl;
     std::cout << "Total Bus Traffic (Bytes): " << bus_stats.data_traffic_bytes << std::endl;
+    if (!prefetcher_name.empty())
+        std::cout << "Prefetch Traffic (Bytes): " << bus_stats.prefetch_traffic_bytes << std::endl;
+    if (split_bus_slots > 0)
+    {
+        double utilization = total_cycles > 0 ? 100.0 * bus_busy_cycles / total_cycles : 0.0;
+        std::cout << "Bus Utilization: " << std::fixed << std::setprecision(2) << utilization << "%" << std::endl;
+        std::cout << "Peak Outstanding Transactions: " << peak_in_flight << std::endl;
+    }
+    if (snoop_filter)
+    {
+        std::cout << "Snoop Probes: " << snoop_filter->probes << std::endl;
+        std::cout << "Snoop Probes Filtered: " << snoop_filter->probes_filtered << std::endl;
+    }
+
+    const L2Stats *l2_stats = l2 ? &l2->stats : nullptr;
+    double l2_miss_rate = 0.0;
+    if (l2_stats)
+    {
+        long long accesses = l2_stats->hits + l2_stats->misses;
+        l2_miss_rate = accesses > 0 ? 100.0 * l2_stats->misses / accesses : 0.0;
+        std::cout << std::endl
+                  << "L2 Summary:" << std::endl;
+        std::cout << "L2 Hits: " << l2_stats->hits << std::endl;
+        std::cout << "L2 Misses: " << l2_stats->misses << std::endl;
+        std::cout << "L2 Miss Rate: " << std::fixed << std::setprecision(2) << l2_miss_rate << "%" << std::endl;
+        std::cout << "L2 Evictions: " << l2_stats->evictions << std::endl;
+        std::cout << "L2 Writebacks: " << l2_stats->writebacks << std::endl;
+        std::cout << "L2 Back-Invalidations: " << l2_stats->back_invalidations << std::endl;
+        std::cout << "L1-L2 Traffic (Bytes): " << bus_stats.l2_traffic_bytes << std::endl;
+        std::cout << "Memory Traffic (Bytes): " << bus_stats.memory_traffic_bytes << std::endl;
+    }
+    if (!latency.empty())
+    {
+        std::cout << std::endl;
+        printLatency();
+    }
+    if (sharing)
+    {
+        std::cout << std::endl;
+        sharing->printReport(std::cout, sharing_top);
+    }
 
     if (outfile.is_open())
     {
         outfile << "Bus Summary\n"
                 << "Total Bus Transactions," << bus_stats.transactions << "\n"
                 << "Total Bus Traffic (Bytes)," << bus_stats.data_traffic_bytes << "\n";
+        if (!prefetcher_name.empty())
+            outfile << "Prefetch Traffic (Bytes)," << bus_stats.prefetch_traffic_bytes << "\n";
+        if (split_bus_slots > 0)
+        {
+            outfile << "Bus Busy Cycles," << bus_busy_cycles << "\n"
+                    << "Peak Outstanding Transactions," << peak_in_flight << "\n";
+        }
+        if (snoop_filter)
+        {
+            outfile << "Snoop Probes," << snoop_filter->probes << "\n"
+                    << "Snoop Probes Filtered," << snoop_filter->probes_filtered << "\n";
+        }
+        if (l2_stats)
+        {
+            outfile << "L2 Hits," << l2_stats->hits << "\n"
+                    << "L2 Misses," << l2_stats->misses << "\n"
+                    << "L2 Miss Rate," << l2_miss_rate << "\n"
+                    << "L2 Evictions," << l2_stats->evictions << "\n"
+                    << "L2 Writebacks," << l2_stats->writebacks << "\n"
+                    << "L2 Back-Invalidations," << l2_stats->back_invalidations << "\n"
+                    << "L1-L2 Traffic (Bytes)," << bus_stats.l2_traffic_bytes << "\n"
+                    << "Memory Traffic (Bytes)," << bus_stats.memory_traffic_bytes << "\n";
+        }
+        if (sharing)
+            sharing->writeCsvRows(outfile, sharing_top);
+    }
+}
+
+void CacheSimulator::writeCsvHeader(std::ostream &out)
+{
+    out << "s,E,b,core,instructions,reads,writes,total_cycles,idle_cycles,misses,miss_rate,"
+        << "evictions,writebacks,invalidations,data_traffic_bytes,bus_transactions,bus_traffic_bytes\n";
+}
+
+void CacheSimulator::writeCsvRows(std::ostream &out) const
+{
+    for (int i = 0; i < num_cores; ++i)
+    {
+        auto stats = caches[i].getStats();
+        const auto &bus_stats_core = core_bus_stats[i];
+        double miss_rate = (stats.instruction_count > 0) ? (100.0 * stats.cache_misses / stats.instruction_count) : 0.0;
+
+        out << s_bits << "," << E_assoc << "," << b_bits << "," << i << ","
+            << stats.instruction_count << "," << stats.read_count << "," << stats.write_count << ","
+            << stats.execution_cycles + stats.idle_cycles << "," << stats.idle_cycles << ","
+            << stats.cache_misses << "," << std::fixed << std::setprecision(4) << miss_rate << ","
+            << stats.evictions << "," << stats.writebacks << ","
+            << bus_stats_core.invalidations << "," << bus_stats_core.data_traffic_bytes << ","
+            << bus_stats.transactions << "," << bus_stats.data_traffic_bytes << "\n";
+    }
+}
+
+void CacheSimulator::printPerformance() const
+{
+    double trace_mb = trace_bytes / (1024.0 * 1024.0);
+    double load_ms = trace_load_seconds * 1000.0;
+    double load_mbps = (trace_load_seconds > 0.0) ? trace_mb / trace_load_seconds : 0.0;
+
+    size_t refs = 0;
+    for (const auto &trace : traces)
+        refs += trace.position();
+    double refs_per_sec = (simulation_seconds > 0.0) ? refs / simulation_seconds : 0.0;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::cout << std::endl
+              << "Host Performance:" << std::endl;
+    std::cout << "Trace Mode: " << (stream_chunk_records > 0 ? "Streaming" : "Loaded") << std::endl;
+    std::cout << "Trace Size (MB): " << std::fixed << std::setprecision(2) << trace_mb << std::endl;
+    if (stream_chunk_records == 0)
+    {
+        // Streamed traces are decoded during the simulation itself
+        std::cout << "Trace Load Time (ms): " << load_ms << std::endl;
+        std::cout << "Trace Load Throughput (MB/s): " << load_mbps << std::endl;
+    }
+    std::cout << "Simulation Time (ms): " << simulation_seconds * 1000.0 << std::endl;
+    std::cout << "Simulation Throughput (refs/s): " << std::setprecision(0) << refs_per_sec << std::endl;
+    std::cout << "Peak RSS (MB): " << std::setprecision(2) << usage.ru_maxrss / 1024.0 << std::endl;
+    if (parallel_threads > 0)
+    {
+        double share = total_cycles > 0 ? 100.0 * parallel_cycles / total_cycles : 0.0;
+        std::cout << "Parallel Engine: " << parallel_workers << " threads, "
+                  << parallel_epochs << " epochs covering " << share << "% of cycles" << std::endl;
     }
 }
 
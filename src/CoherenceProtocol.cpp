@@ -0,0 +1,68 @@
+#include "../include/CoherenceProtocol.h"
+
+const char *const PROTOCOL_NAMES = "mesi, moesi, mesif";
+
+namespace
+{
+    using S = MESIState;
+
+    // Columns: READ, READ_EXCLUSIVE, UPGRADE. Rows for states a protocol never
+    // uses are left INVALID.
+    const SnoopAction NONE = {S::INVALID, false, false};
+
+    // A dirty block read by another core is written back as it is shared
+    const ProtocolTable MESI = {
+        "MESI",
+        {
+            /* MODIFIED  */ {{S::SHARED, true, true}, {S::INVALID, true, true}, {S::MODIFIED, false, false}},
+            /* EXCLUSIVE */ {{S::SHARED, true, false}, {S::INVALID, true, false}, {S::EXCLUSIVE, false, false}},
+            /* SHARED    */ {{S::SHARED, true, false}, {S::INVALID, true, false}, {S::INVALID, false, false}},
+            /* INVALID   */ {NONE, NONE, NONE},
+            /* OWNED     */ {NONE, NONE, NONE},
+            /* FORWARD   */ {NONE, NONE, NONE},
+        },
+        S::SHARED,
+    };
+
+    // The reader shares a dirty block with its OWNED holder, which writes it back
+    // only when evicted
+    const ProtocolTable MOESI = {
+        "MOESI",
+        {
+            /* MODIFIED  */ {{S::OWNED, true, false}, {S::INVALID, true, true}, {S::MODIFIED, false, false}},
+            /* EXCLUSIVE */ {{S::SHARED, true, false}, {S::INVALID, true, false}, {S::EXCLUSIVE, false, false}},
+            /* SHARED    */ {{S::SHARED, true, false}, {S::INVALID, true, false}, {S::INVALID, false, false}},
+            /* INVALID   */ {NONE, NONE, NONE},
+            /* OWNED     */ {{S::OWNED, true, false}, {S::INVALID, true, true}, {S::INVALID, false, false}},
+            /* FORWARD   */ {NONE, NONE, NONE},
+        },
+        S::SHARED,
+    };
+
+    // Only the FORWARD copy (or a sole E/M copy) answers a read, and the newest
+    // reader takes over as forwarder. SHARED copies stay silent, so a block whose
+    // forwarder was evicted comes from memory.
+    const ProtocolTable MESIF = {
+        "MESIF",
+        {
+            /* MODIFIED  */ {{S::SHARED, true, true}, {S::INVALID, true, true}, {S::MODIFIED, false, false}},
+            /* EXCLUSIVE */ {{S::SHARED, true, false}, {S::INVALID, true, false}, {S::EXCLUSIVE, false, false}},
+            /* SHARED    */ {{S::SHARED, false, false}, {S::INVALID, false, false}, {S::INVALID, false, false}},
+            /* INVALID   */ {NONE, NONE, NONE},
+            /* OWNED     */ {NONE, NONE, NONE},
+            /* FORWARD   */ {{S::SHARED, true, false}, {S::INVALID, true, false}, {S::INVALID, false, false}},
+        },
+        S::FORWARD,
+    };
+}
+
+const ProtocolTable *findProtocol(const std::string &name)
+{
+    if (name == "mesi")
+        return &MESI;
+    if (name == "moesi")
+        return &MOESI;
+    if (name == "mesif")
+        return &MESIF;
+    return nullptr;
+}
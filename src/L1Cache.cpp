@@ -1,18 +1,80 @@
 #include "../include/L1Cache.h"
 #include "../include/CacheSimulator.h"
+#include "../include/TagMatch.h"
+#include "../include/SnoopFilter.h"
+#include <cassert>
 #include <iostream>
 #include <algorithm>
 #include <iomanip>
 
-// Reference the global DEBUG_MODE variable defined in main.cpp
-extern bool DEBUG_MODE;
-
 L1Cache::L1Cache(int id, int s_bits, int b_bits, int assoc)
     : core_id(id), E(assoc), s(s_bits), b(b_bits)
 {
     S = 1 << s;
     B = 1 << b;
-    cache_sets.resize(S);
+    tags.assign(S * E, INVALID_TAG);
+    states.assign(S * E, MESIState::INVALID);
+    allocated.assign(S * E, 0);
+    prefetched.assign(S * E, 0);
+    policy = makeReplacementPolicy("lru", S, E);
+    protocol = findProtocol("mesi");
+}
+
+void L1Cache::enableDataTracking()
+{
+    data.assign(static_cast<size_t>(S) * E * B, 0);
+}
+
+void L1Cache::attachSnoopFilter(SnoopFilter *filter)
+{
+    snoop_filter = filter;
+}
+
+void L1Cache::setDebug(bool enabled)
+{
+    debug = enabled;
+}
+
+void L1Cache::setMshrs(int count)
+{
+    mshr_count = count;
+    mshrs.reserve(count);
+}
+
+void L1Cache::setWriteBuffer(int depth)
+{
+    assert(depth >= 0);
+    write_buffer_depth = depth;
+}
+
+void L1Cache::setReplacementPolicy(std::unique_ptr<ReplacementPolicy> replacement)
+{
+    policy = std::move(replacement);
+}
+
+void L1Cache::attachPrefetcher(std::unique_ptr<Prefetcher> prefetcher_model)
+{
+    prefetcher = std::move(prefetcher_model);
+}
+
+void L1Cache::setCleanEvictions(bool enabled)
+{
+    clean_evictions = enabled;
+}
+
+void L1Cache::setProtocol(const ProtocolTable *table)
+{
+    protocol = table;
+}
+
+void L1Cache::attachMissProfiler(std::unique_ptr<MissProfiler> profiler)
+{
+    miss_profiler = std::move(profiler);
+}
+
+void L1Cache::enableAccessLatency()
+{
+    access_latency = std::make_unique<AccessLatency>();
 }
 
 CoreStats L1Cache::getStats() const
@@ -30,36 +92,183 @@ void L1Cache::unblock(int cycle)
     is_blocked = false;
 }
 
+bool L1Cache::hasOutstandingMisses() const
+{
+    return !mshrs.empty();
+}
+
+void L1Cache::waitForMisses(int cycle)
+{
+    is_blocked = true;
+}
+
 int L1Cache::getSetIndex(uint32_t address) const
 {
-    return (address >> b) & ((1 << s) - 1);
+    return setIndexOf(address, s, b);
 }
 
 uint32_t L1Cache::getTag(uint32_t address) const
 {
-    return address >> (s + b);
+    return tagOf(address, s, b);
 }
 
-CacheLine *L1Cache::findLineByTag(int set_index, uint32_t tag)
+int L1Cache::findWay(int set_index, uint32_t tag) const
 {
-    auto &set = cache_sets[set_index];
-    for (auto it = set.begin(); it != set.end(); ++it)
+    int base = set_index * E;
+    int way = matchTag(&tags[base], E, tag);
+    return way < 0 ? -1 : base + way;
+}
+
+uint32_t L1Cache::lineAddress(int line) const
+{
+    return (tags[line] << (s + b)) | ((line / E) << b);
+}
+
+void L1Cache::touch(int line)
+{
+    policy->onHit(line / E, line % E);
+    if (prefetched[line])
     {
-        if (it->valid && it->tag == tag && it->state != MESIState::INVALID)
-        {
-            moveToFront(set_index, it);
-            return &(*it);
-        }
+        prefetched[line] = 0;
+        stats.prefetch_hits++;
+    }
+}
+
+void L1Cache::invalidate(int line)
+{
+    if (snoop_filter != nullptr && tags[line] != INVALID_TAG)
+        snoop_filter->remove(core_id, lineAddress(line));
+    if (prefetched[line])
+    {
+        prefetched[line] = 0;
+        stats.prefetch_unused++;
+    }
+    states[line] = MESIState::INVALID;
+    tags[line] = INVALID_TAG;
+}
+
+int L1Cache::chooseFillWay(int set_index, int skip_line)
+{
+    // A way keeps its slot after being invalidated by a snoop, so eviction is only
+    // needed once every way of the set has been filled
+    int base = set_index * E;
+    for (int w = 0; w < E; ++w)
+    {
+        if (!allocated[base + w] && base + w != skip_line)
+            return base + w;
+    }
+    int line = base + policy->victim(set_index);
+    return line == skip_line ? -1 : line;
+}
+
+void L1Cache::evictLine(int line, int current_cycle, std::vector<BusRequest> &bus_reqs)
+{
+    stats.evictions++;
+
+    // Calculate the physical address of the victim line
+    bool dirty = isDirtyState(states[line]);
+    uint32_t victim_addr = lineAddress(line);
+    if (miss_profiler)
+    {
+        bool has_block = tags[line] != INVALID_TAG;
+        miss_profiler->eviction(line / E, has_block ? std::optional<uint32_t>(victim_addr) : std::nullopt);
+    }
+    invalidate(line);
+
+    if (!dirty)
+    {
+        if (clean_evictions)
+            bus_reqs.emplace_back(core_id, BusOperation::EVICT_CLEAN, victim_addr, current_cycle, 0);
+        return;
+    }
+    stats.writebacks++;
+    writeBack(victim_addr, current_cycle, bus_reqs);
+}
+
+void L1Cache::fill(int line, uint32_t address, MESIState state)
+{
+    invalidate(line);
+    tags[line] = getTag(address);
+    states[line] = state;
+    allocated[line] = 1;
+    policy->onFill(line / E, line % E);
+    if (snoop_filter != nullptr)
+        snoop_filter->add(core_id, address);
+}
+
+MSHR *L1Cache::findMshr(uint32_t address)
+{
+    uint32_t block = address >> b;
+    for (auto &mshr : mshrs)
+    {
+        if ((mshr.address >> b) == block)
+            return &mshr;
     }
     return nullptr;
 }
 
-void L1Cache::moveToFront(int set_index, std::list<CacheLine>::iterator it)
+bool L1Cache::hasBufferedWriteback() const
+{
+    return !write_buffer.empty();
+}
+
+uint32_t L1Cache::popBufferedWriteback()
+{
+    uint32_t address = write_buffer.front();
+    removeBuffered(write_buffer.begin());
+    return address;
+}
+
+void L1Cache::removeBuffered(std::deque<uint32_t>::iterator entry)
 {
-    if (it != cache_sets[set_index].begin())
+    if (snoop_filter != nullptr)
+        snoop_filter->remove(core_id, *entry);
+    write_buffer.erase(entry);
+}
+
+void L1Cache::writeBack(uint32_t victim_addr, int current_cycle, std::vector<BusRequest> &bus_reqs)
+{
+    if (write_buffer_depth == 0)
     {
-        cache_sets[set_index].splice(cache_sets[set_index].begin(), cache_sets[set_index], it);
+        bus_reqs.emplace_back(core_id, BusOperation::FLUSH, victim_addr, current_cycle, 100);
+        return;
     }
+
+    // A full buffer pushes its oldest entry onto the bus ahead of the miss
+    bool full = static_cast<int>(write_buffer.size()) >= write_buffer_depth;
+    if (full)
+    {
+        stats.wb_full_stalls++;
+        bus_reqs.emplace_back(core_id, BusOperation::FLUSH, popBufferedWriteback(), current_cycle, 100);
+    }
+
+    // Buffered blocks stay visible to the snoop filter until they drain
+    write_buffer.push_back(victim_addr);
+    if (snoop_filter != nullptr)
+        snoop_filter->add(core_id, victim_addr);
+    stats.wb_buffered++;
+}
+
+void L1Cache::recallWriteback(uint32_t address, int current_cycle, std::vector<BusRequest> &bus_reqs)
+{
+    // Missing on a block still in the buffer: write it back before refetching it,
+    // so a block is never both cached and buffered
+    uint32_t block = address >> b;
+    for (auto it = write_buffer.begin(); it != write_buffer.end(); ++it)
+    {
+        if ((*it >> b) == block)
+        {
+            bus_reqs.emplace_back(core_id, BusOperation::FLUSH, *it, current_cycle, 100);
+            removeBuffered(it);
+            return;
+        }
+    }
+}
+
+void L1Cache::trackOccupancy(int current_cycle)
+{
+    stats.mshr_occupancy_cycles += static_cast<long long>(mshrs.size()) * (current_cycle - occupancy_since);
+    occupancy_since = current_cycle;
 }
 
 void L1Cache::addExecutionCycle(int cycles)
@@ -72,6 +281,17 @@ void L1Cache::addIdleCycle(int cycles)
     stats.idle_cycles += cycles;
 }
 
+void L1Cache::addDrainCycles(int cycles)
+{
+    stats.wb_drain_cycles += cycles;
+}
+
+void L1Cache::addComputeCycles(int cycles)
+{
+    stats.execution_cycles += cycles;
+    stats.compute_cycles += cycles;
+}
+
 int L1Cache::getBlockSize() const
 {
     return B;
@@ -89,6 +309,10 @@ std::string L1Cache::stateToString(MESIState state) const
         return "SHARED";
     case MESIState::INVALID:
         return "INVALID";
+    case MESIState::OWNED:
+        return "OWNED";
+    case MESIState::FORWARD:
+        return "FORWARD";
     default:
         return "UNKNOWN";
     }
@@ -103,7 +327,7 @@ bool L1Cache::processMemoryRequest(const MemRef &mem_ref, int current_cycle,
     uint32_t address = mem_ref.address;
     bool is_write = mem_ref.is_write;
 
-    if (DEBUG_MODE)
+    if (debug)
     {
         std::cout << "[CYCLE " << std::setw(6) << current_cycle << "] "
                   << "Core " << core_id << " processes "
@@ -111,18 +335,70 @@ bool L1Cache::processMemoryRequest(const MemRef &mem_ref, int current_cycle,
                   << std::hex << address << std::dec << std::endl;
     }
 
+    if (miss_profiler && !retrying)
+    {
+        // A secondary miss on a block an MSHR is already fetching is not a new miss
+        bool present = findWay(getSetIndex(address), getTag(address)) >= 0 || findMshr(address) != nullptr;
+        miss_profiler->access(address, present);
+    }
+
+    if (!retrying)
+        access_start = current_cycle;
+
+    // The prefetcher sees each access once, on its first attempt
+    bool train = prefetcher && !retrying;
+    bool trigger = false;
+    if (train)
+    {
+        int line = findWay(getSetIndex(address), getTag(address));
+        trigger = line < 0 || prefetched[line];
+    }
+
+    bool completed = mshr_count > 0 ? processNonBlocking(mem_ref, current_cycle, bus_reqs)
+                                    : processBlocking(mem_ref, current_cycle, bus_reqs);
+    if (access_latency && mshr_count == 0)
+    {
+        // A blocking access waits from its first attempt until its retry completes,
+        // across a late prefetch or an upgrade that has to become a miss
+        if (!completed && !retrying)
+        {
+            bool cached = findWay(getSetIndex(address), getTag(address)) >= 0;
+            access_kind = cached ? AccessKind::UPGRADE : (is_write ? AccessKind::WRITE_MISS : AccessKind::READ_MISS);
+        }
+        else if (completed && retrying)
+        {
+            access_latency->by_kind[static_cast<int>(access_kind)].add(current_cycle - access_start);
+        }
+    }
+    retrying = !completed;
+    if (train)
+        issuePrefetches(address, trigger, current_cycle, bus_reqs);
+    return completed;
+}
+
+bool L1Cache::processBlocking(const MemRef &mem_ref, int current_cycle,
+                              std::vector<BusRequest> &bus_reqs)
+{
+    uint32_t address = mem_ref.address;
+    bool is_write = mem_ref.is_write;
     int set_index = getSetIndex(address);
     uint32_t tag = getTag(address);
 
     // Check for hit
-    CacheLine *line = findLineByTag(set_index, tag);
+    int line = findWay(set_index, tag);
+
+    // The first access after a fill is the missed access itself, retried; its use
+    // was already reported as the fill
+    bool retried_fill = line >= 0 && line == filled_line;
+    filled_line = -1;
 
     // HIT
-    if (line != nullptr)
+    if (line >= 0)
     {
         stats.cache_hits++;
+        if (!retried_fill)
+            touch(line);
 
-        // Line is already moved to front by findLineByTag
         if (!is_write)
         {
             // Read hit - no state change, takes 1 cycle
@@ -130,7 +406,7 @@ bool L1Cache::processMemoryRequest(const MemRef &mem_ref, int current_cycle,
         }
 
         // Write hit - handle based on current state
-        switch (line->state)
+        switch (states[line])
         {
         case MESIState::MODIFIED:
             // Already modified, no state change needed
@@ -138,10 +414,12 @@ bool L1Cache::processMemoryRequest(const MemRef &mem_ref, int current_cycle,
 
         case MESIState::EXCLUSIVE:
             // Silently transition to Modified
-            line->state = MESIState::MODIFIED;
+            states[line] = MESIState::MODIFIED;
             return true;
 
         case MESIState::SHARED:
+        case MESIState::OWNED:
+        case MESIState::FORWARD:
             // Need to invalidate copies in other caches
             bus_reqs.emplace_back(core_id, BusOperation::BUS_UPGR, address, current_cycle, 1);
             is_blocked = true;
@@ -149,7 +427,7 @@ bool L1Cache::processMemoryRequest(const MemRef &mem_ref, int current_cycle,
             return false;
 
         case MESIState::INVALID:
-            // Should not happen since we check for INVALID in findLineByTag, but just in case
+            // Should not happen since findWay only matches valid lines, but just in case
             return false;
         }
     }
@@ -157,30 +435,29 @@ bool L1Cache::processMemoryRequest(const MemRef &mem_ref, int current_cycle,
     // MISS
     stats.cache_misses++;
 
-    auto &set = cache_sets[set_index];
-    bool eviction_needed = (int)set.size() >= E;
-
-    if (eviction_needed)
+    if (prefetchInFlight(address))
     {
-        stats.evictions++;
-
-        // Get the LRU line (back of list)
-        CacheLine &victim_line = set.back();
-
-        if (victim_line.state == MESIState::MODIFIED)
-        {
-            stats.writebacks++;
+        // Already being prefetched: wait for that fill instead of asking again
+        stats.prefetch_late++;
+        late_prefetch = address;
+        waiting_for_prefetch = true;
+        is_blocked = true;
+        pending_request = mem_ref;
+        return false;
+    }
 
-            // Calculate the physical address of the victim line
-            uint32_t victim_addr = (victim_line.tag << (s + b)) | (set_index << b);
+    recallWriteback(address, current_cycle, bus_reqs);
 
-            // Create a flush request for the writeback
-            bus_reqs.emplace_back(core_id, BusOperation::FLUSH, victim_addr, current_cycle, 100);
-        }
+    int victim = chooseFillWay(set_index);
+    if (allocated[victim])
+    {
+        // Flush a dirty victim, unless the write buffer takes it off the miss's path
+        evictLine(victim, current_cycle, bus_reqs);
 
-        // Remove the LRU line
-        set.pop_back();
+        // Free the victim's way for the incoming line
+        allocated[victim] = 0;
     }
+    reserved_line = victim;
 
     // Issue the appropriate bus request for the miss
     BusOperation op = is_write ? BusOperation::BUS_RDX : BusOperation::BUS_RD;
@@ -192,84 +469,116 @@ bool L1Cache::processMemoryRequest(const MemRef &mem_ref, int current_cycle,
     return false;
 }
 
-void L1Cache::handleBusRequest(const BusRequest &bus_req, int current_cycle,
-                               bool &provide_data, int &transfer_cycles)
+void L1Cache::handleBusRequest(const BusRequest &bus_req, int current_cycle, SnoopResponse &response)
 {
     // Don't process our own requests
     if (bus_req.core_id == core_id)
         return;
 
-    provide_data = false;
-    transfer_cycles = 0;
+    response = SnoopResponse();
 
     uint32_t address = bus_req.address;
     int set_index = getSetIndex(address);
     uint32_t tag = getTag(address);
 
-    CacheLine *line = findLineByTag(set_index, tag);
-    if (line == nullptr)
+    int line = findWay(set_index, tag);
+    if (line < 0)
+    {
+        snoopWriteBuffer(bus_req, response);
         return;
+    }
 
+    SnoopEvent event;
     switch (bus_req.operation)
     {
     case BusOperation::BUS_RD:
-        if (line->state != MESIState::INVALID)
-        {
-            line->state = MESIState::SHARED;
-            provide_data = true;
-            transfer_cycles = 2 * (getBlockSize() / 4);
-        }
+        event = SnoopEvent::READ;
         break;
-
     case BusOperation::BUS_RDX:
-        if (line->state != MESIState::INVALID)
-        {
-            // Another core wants exclusive access, invalidate our copy
-            if (line->state == MESIState::MODIFIED)
-            {
-                // We have the most recent data, provide it
-                stats.writebacks++;
-                line->state = MESIState::INVALID;
-                line->valid = false;
-                provide_data = true;
-                transfer_cycles = 100;
-            }
-            else
-            {
-                line->state = MESIState::INVALID;
-                line->valid = false;
-                provide_data = true;
-                transfer_cycles = 2 * (getBlockSize() / 4);
-            }
-        }
+        event = SnoopEvent::READ_EXCLUSIVE;
         break;
-
     case BusOperation::BUS_UPGR:
-        if (line->state == MESIState::SHARED)
-        {
-            line->state = MESIState::INVALID;
-            line->valid = false;
-        }
+        event = SnoopEvent::UPGRADE;
         break;
-
-    case BusOperation::FLUSH:
-    case BusOperation::FLUSH_OPT:
+    default:
         // Nothing to do, memory controller handles this
-        break;
+        return;
+    }
+
+    const SnoopAction &action = protocol->onSnoop(states[line], event);
+    response.had_copy = true;
+    response.provide_data = action.supplies;
+    response.flushed = action.flushes;
+    if (action.supplies)
+    {
+        // Dirty data taken for writing goes by way of memory
+        bool via_memory = event == SnoopEvent::READ_EXCLUSIVE && action.flushes;
+        response.transfer_cycles = via_memory ? 100 : 2 * (getBlockSize() / 4);
+    }
+    if (action.flushes)
+        stats.writebacks++;
+
+    response.invalidated = action.next == MESIState::INVALID;
+    if (response.invalidated)
+    {
+        invalidate(line);
+        if (miss_profiler)
+            miss_profiler->invalidation(address);
+    }
+    else
+        states[line] = action.next;
+}
+
+void L1Cache::snoopWriteBuffer(const BusRequest &bus_req, SnoopResponse &response)
+{
+    uint32_t block = bus_req.address >> b;
+    auto entry = std::find_if(write_buffer.begin(), write_buffer.end(),
+                              [&](uint32_t address) { return (address >> b) == block; });
+    if (entry == write_buffer.end())
+        return;
+
+    // A buffered block is the only up-to-date copy, so it is supplied like a
+    // MODIFIED line
+    if (bus_req.operation == BusOperation::BUS_RD)
+    {
+        stats.wb_forwards++;
+        response.had_copy = true;
+        response.provide_data = true;
+        response.transfer_cycles = 2 * (getBlockSize() / 4);
+    }
+    else if (bus_req.operation == BusOperation::BUS_RDX)
+    {
+        // The requester takes ownership of the dirty data, so the writeback is dropped
+        stats.wb_forwards++;
+        removeBuffered(entry);
+        response.provide_data = true;
+        response.transfer_cycles = 100;
+    }
+    else if (bus_req.operation == BusOperation::BUS_UPGR)
+    {
+        // The upgrader holds a copy forwarded from this buffer and is about to
+        // own it dirty; draining the stale entry later would overwrite its data
+        removeBuffered(entry);
     }
 }
 
-void L1Cache::completeMemoryRequest(int current_cycle, bool is_upgrade,
+void L1Cache::completeMemoryRequest(int current_cycle, uint32_t address, bool is_upgrade,
                                     bool received_data_from_cache,
-                                    MESIState new_state)
+                                    MESIState new_state, std::vector<BusRequest> &bus_reqs)
 {
+    if (mshr_count > 0)
+    {
+        completeNonBlocking(current_cycle, address, is_upgrade, new_state, bus_reqs);
+        return;
+    }
+
     if (!is_blocked)
         return;
 
-    uint32_t address = pending_request.address;
+    address = pending_request.address;
     bool is_write = pending_request.is_write;
 
-    if (DEBUG_MODE)
+    if (debug)
     {
         std::cout << "[CYCLE " << std::setw(6) << current_cycle << "] "
                   << "Core " << core_id << " completing "
@@ -286,31 +595,385 @@ void L1Cache::completeMemoryRequest(int current_cycle, bool is_upgrade,
     if (is_upgrade)
     {
         // Upgrade existing line state
-        CacheLine *line = findLineByTag(set_index, tag);
-        if (line != nullptr)
+        int line = findWay(set_index, tag);
+        if (line >= 0)
         {
-            line->state = new_state;
-            line->valid = true;
-            line->tag = tag;
+            touch(line);
+            states[line] = new_state;
         }
     }
     else
     {
-        auto &set = cache_sets[set_index];
-        set.push_front(CacheLine());
-
-        // Set up the new line
-        CacheLine &line = set.front();
-        line.valid = true;
-        line.tag = tag;
-        line.state = new_state;
-        line.data.resize(B);
+        // The miss freed a way when it was issued; fall back to the policy's victim if not
+        filled_line = chooseFillWay(set_index);
+        fill(filled_line, address, new_state);
+        reserved_line = -1;
     }
 
     // Unblock the cache as the memory request is complete
     is_blocked = false;
 }
 
+bool L1Cache::processNonBlocking(const MemRef &mem_ref, int current_cycle,
+                                 std::vector<BusRequest> &bus_reqs)
+{
+    uint32_t address = mem_ref.address;
+    bool is_write = mem_ref.is_write;
+    int line = findWay(getSetIndex(address), getTag(address));
+    MSHR *mshr = findMshr(address);
+
+    // Hit under miss: a hit needs no MSHR unless it is a write to a shared line
+    if (line >= 0 && (!is_write || !needsUpgrade(states[line])))
+    {
+        stats.cache_hits++;
+        touch(line);
+        if (is_write)
+            states[line] = MESIState::MODIFIED;
+        return true;
+    }
+
+    // Primary miss or upgrade with every MSHR busy: retry once one frees up
+    if (mshr == nullptr && static_cast<int>(mshrs.size()) >= mshr_count)
+    {
+        stats.mshr_full_stalls++;
+        is_blocked = true;
+        return false;
+    }
+
+    if (line >= 0)
+        stats.cache_hits++;
+    else
+        stats.cache_misses++;
+    AccessKind kind = line >= 0 ? AccessKind::UPGRADE : (is_write ? AccessKind::WRITE_MISS : AccessKind::READ_MISS);
+
+    // Secondary miss: the block is already on its way
+    if (mshr != nullptr)
+    {
+        stats.mshr_merges++;
+        if (line >= 0)
+            touch(line);
+        if (is_write && mshr->operation == BusOperation::BUS_RD)
+            mshr->pending_write = true;
+        if (access_latency)
+            merged_accesses.push_back({address >> b, access_start, kind});
+        return true;
+    }
+
+    BusOperation op = line >= 0 ? BusOperation::BUS_UPGR : (is_write ? BusOperation::BUS_RDX : BusOperation::BUS_RD);
+    if (line >= 0)
+        touch(line);
+
+    // A block already being prefetched takes an MSHR that waits for the prefetch
+    bool waits_on_prefetch = line < 0 && prefetchInFlight(address);
+    if (waits_on_prefetch)
+    {
+        stats.prefetch_late++;
+        late_prefetch = address;
+        op = BusOperation::BUS_RD;
+    }
+    else if (line < 0)
+    {
+        recallWriteback(address, current_cycle, bus_reqs);
+    }
+
+    // The victim is chosen when the block arrives, so the set keeps serving hits meanwhile
+    trackOccupancy(current_cycle);
+    mshrs.push_back({address, op, access_start, waits_on_prefetch && is_write, kind});
+    stats.mshr_peak = std::max(stats.mshr_peak, static_cast<long long>(mshrs.size()));
+    if (!waits_on_prefetch)
+        bus_reqs.emplace_back(core_id, op, address, current_cycle, op == BusOperation::BUS_UPGR ? 1 : 0);
+    return true;
+}
+
+void L1Cache::completeNonBlocking(int current_cycle, uint32_t address, bool is_upgrade,
+                                  MESIState new_state, std::vector<BusRequest> &bus_reqs)
+{
+    // Any completion may free the MSHR a stalled access is waiting for
+    is_blocked = false;
+
+    MSHR *mshr = findMshr(address);
+    if (mshr == nullptr)
+        return;
+
+    if (debug)
+    {
+        std::cout << "[CYCLE " << std::setw(6) << current_cycle << "] "
+                  << "Core " << core_id << " completing MSHR for 0x"
+                  << std::hex << mshr->address << std::dec
+                  << " | New state: " << stateToString(new_state) << std::endl;
+    }
+
+    int set_index = getSetIndex(address);
+    uint32_t tag = getTag(address);
+    int line = findWay(set_index, tag);
+
+    if (is_upgrade && line < 0)
+    {
+        // Another core's write invalidated the shared copy before the upgrade won
+        // the bus, so the block has to be fetched again
+        mshr->operation = BusOperation::BUS_RDX;
+        bus_reqs.emplace_back(core_id, BusOperation::BUS_RDX, mshr->address, current_cycle, 0);
+        return;
+    }
+
+    if (!is_upgrade)
+    {
+        line = chooseFillWay(set_index);
+        if (allocated[line])
+            evictLine(line, current_cycle, bus_reqs);
+        fill(line, address, new_state);
+    }
+    else
+    {
+        touch(line);
+        states[line] = new_state;
+    }
+    finishMshr(mshr, line, new_state, current_cycle, bus_reqs);
+}
+
+void L1Cache::finishMshr(MSHR *mshr, int line, MESIState new_state, int current_cycle,
+                         std::vector<BusRequest> &bus_reqs)
+{
+    if (mshr->pending_write)
+    {
+        if (needsUpgrade(new_state))
+        {
+            // A write merged into the read still needs the other copies invalidated
+            mshr->operation = BusOperation::BUS_UPGR;
+            mshr->pending_write = false;
+            bus_reqs.emplace_back(core_id, BusOperation::BUS_UPGR, mshr->address, current_cycle, 1);
+            return;
+        }
+        states[line] = MESIState::MODIFIED;
+    }
+
+    if (access_latency)
+    {
+        // The primary access and every access merged into it are served now
+        uint32_t block = mshr->address >> b;
+        access_latency->by_kind[static_cast<int>(mshr->kind)].add(current_cycle - mshr->issue_cycle);
+        for (const MergedAccess &merged : merged_accesses)
+        {
+            if (merged.block == block)
+                access_latency->by_kind[static_cast<int>(merged.kind)].add(current_cycle - merged.start_cycle);
+        }
+        merged_accesses.erase(std::remove_if(merged_accesses.begin(), merged_accesses.end(),
+                                             [&](const MergedAccess &merged) { return merged.block == block; }),
+                              merged_accesses.end());
+    }
+
+    trackOccupancy(current_cycle);
+    mshrs.erase(mshrs.begin() + (mshr - mshrs.data()));
+}
+
+bool L1Cache::backInvalidate(uint32_t address, bool &dirty)
+{
+    // A buffered victim leaves with the block, its writeback going to memory
+    // now; it was counted as a writeback when it was evicted
+    uint32_t block = address >> b;
+    auto entry = std::find_if(write_buffer.begin(), write_buffer.end(),
+                              [&](uint32_t buffered) { return (buffered >> b) == block; });
+    bool buffered = entry != write_buffer.end();
+    if (buffered)
+        removeBuffered(entry);
+
+    // The way keeps its slot, as after a snoop invalidation
+    int line = findWay(getSetIndex(address), getTag(address));
+    dirty = buffered;
+    if (line < 0)
+        return buffered;
+    if (isDirtyState(states[line]))
+    {
+        stats.writebacks++;
+        dirty = true;
+    }
+    invalidate(line);
+    return true;
+}
+
+std::vector<uint32_t> L1Cache::heldBlocks() const
+{
+    std::vector<uint32_t> blocks(write_buffer.begin(), write_buffer.end());
+    for (int line = 0; line < S * E; ++line)
+    {
+        if (tags[line] != INVALID_TAG)
+            blocks.push_back(lineAddress(line));
+    }
+    return blocks;
+}
+
+bool L1Cache::takeLatePrefetch(uint32_t &address)
+{
+    if (!late_prefetch)
+        return false;
+    address = *late_prefetch;
+    late_prefetch.reset();
+    return true;
+}
+
+bool L1Cache::prefetchInFlight(uint32_t address) const
+{
+    return std::find(prefetch_blocks.begin(), prefetch_blocks.end(), address >> b) != prefetch_blocks.end();
+}
+
+void L1Cache::issuePrefetches(uint32_t address, bool trigger, int current_cycle,
+                              std::vector<BusRequest> &bus_reqs)
+{
+    std::vector<uint32_t> candidates;
+    prefetcher->observe(address >> b, trigger, candidates);
+
+    for (uint32_t block : candidates)
+    {
+        if (static_cast<int>(prefetch_blocks.size()) >= MAX_PREFETCHES)
+            break;
+
+        // Skip blocks past the end of the address space, and blocks that are cached,
+        // already requested, or waiting in the write buffer
+        if (block > (UINT32_MAX >> b))
+            continue;
+        uint32_t block_addr = block << b;
+        bool pending_demand = mshr_count == 0 && is_blocked && (pending_request.address >> b) == block;
+        bool buffered = std::find_if(write_buffer.begin(), write_buffer.end(),
+                                     [&](uint32_t a) { return (a >> b) == block; }) != write_buffer.end();
+        if (findWay(getSetIndex(block_addr), getTag(block_addr)) >= 0 || prefetchInFlight(block_addr) ||
+            findMshr(block_addr) != nullptr || pending_demand || buffered)
+            continue;
+
+        bus_reqs.emplace_back(core_id, BusOperation::BUS_RD, block_addr, current_cycle, 0);
+        bus_reqs.back().is_prefetch = true;
+        prefetch_blocks.push_back(block);
+        stats.prefetches_issued++;
+    }
+}
+
+void L1Cache::completePrefetch(int current_cycle, uint32_t address, MESIState new_state,
+                               std::vector<BusRequest> &bus_reqs)
+{
+    uint32_t block = address >> b;
+    prefetch_blocks.erase(std::find(prefetch_blocks.begin(), prefetch_blocks.end(), block));
+
+    // In non-blocking mode the fill may free an MSHR a stalled access is waiting for
+    if (mshr_count > 0)
+        is_blocked = false;
+
+    int set_index = getSetIndex(address);
+    if (findWay(set_index, getTag(address)) >= 0)
+        return;
+
+    if (debug)
+    {
+        std::cout << "[CYCLE " << std::setw(6) << current_cycle << "] "
+                  << "Core " << core_id << " prefetch fill at 0x"
+                  << std::hex << address << std::dec
+                  << " | New state: " << stateToString(new_state) << std::endl;
+    }
+
+    // Never take the way a blocking miss has freed for its own fill
+    int line = chooseFillWay(set_index, reserved_line);
+    if (line < 0)
+        return;
+    if (allocated[line])
+        evictLine(line, current_cycle, bus_reqs);
+    fill(line, address, new_state);
+
+    MSHR *mshr = findMshr(address);
+    if (waiting_for_prefetch && (pending_request.address >> b) == block)
+    {
+        // The blocked access retries and finds the block
+        waiting_for_prefetch = false;
+        is_blocked = false;
+        filled_line = line;
+    }
+    else if (mshr != nullptr)
+    {
+        finishMshr(mshr, line, new_state, current_cycle, bus_reqs);
+    }
+    else
+    {
+        prefetched[line] = 1;
+    }
+}
+
+bool L1Cache::warmAccess(const MemRef &mem_ref, BusOperation &op, std::optional<BusOperation> &eviction,
+                         uint32_t &victim_address)
+{
+    uint32_t address = mem_ref.address;
+    int set_index = getSetIndex(address);
+    int line = findWay(set_index, getTag(address));
+
+    // An access retried after its fill was already counted as a use
+    bool retried_fill = line >= 0 && line == filled_line;
+    filled_line = -1;
+    retrying = false;
+    eviction.reset();
+    if (miss_profiler && !retried_fill)
+        miss_profiler->access(address, line >= 0);
+
+    if (line >= 0)
+    {
+        stats.cache_hits++;
+        if (!retried_fill)
+            touch(line);
+        if (!mem_ref.is_write || states[line] == MESIState::MODIFIED)
+            return false;
+        if (states[line] == MESIState::EXCLUSIVE)
+        {
+            states[line] = MESIState::MODIFIED;
+            return false;
+        }
+        op = BusOperation::BUS_UPGR;
+        return true;
+    }
+
+    stats.cache_misses++;
+    int victim = chooseFillWay(set_index);
+    if (allocated[victim])
+    {
+        // A way emptied by a snoop holds no block to write back
+        bool has_block = tags[victim] != INVALID_TAG;
+        bool dirty = isDirtyState(states[victim]);
+        victim_address = lineAddress(victim);
+        stats.evictions++;
+        if (miss_profiler)
+            miss_profiler->eviction(set_index, has_block ? std::optional<uint32_t>(victim_address) : std::nullopt);
+        invalidate(victim);
+        allocated[victim] = 0;
+        if (has_block && dirty)
+        {
+            stats.writebacks++;
+            eviction = BusOperation::FLUSH;
+        }
+        else if (has_block && clean_evictions)
+        {
+            eviction = BusOperation::EVICT_CLEAN;
+        }
+    }
+    op = mem_ref.is_write ? BusOperation::BUS_RDX : BusOperation::BUS_RD;
+    return true;
+}
+
+void L1Cache::warmFill(const MemRef &mem_ref, BusOperation op, MESIState new_state)
+{
+    int set_index = getSetIndex(mem_ref.address);
+    if (op == BusOperation::BUS_UPGR)
+    {
+        int line = findWay(set_index, getTag(mem_ref.address));
+        if (line >= 0)
+            states[line] = new_state;
+        return;
+    }
+    fill(chooseFillWay(set_index), mem_ref.address, new_state);
+}
+
+bool L1Cache::hitsLocally(const MemRef &mem_ref) const
+{
+    // Any access may train the prefetcher into issuing requests
+    if (is_blocked || prefetcher)
+        return false;
+    int line = findWay(getSetIndex(mem_ref.address), getTag(mem_ref.address));
+    return line >= 0 && (!mem_ref.is_write || !needsUpgrade(states[line]));
+}
+
 void L1Cache::recordInstruction(bool is_write)
 {
     stats.instruction_count++;
@@ -322,4 +985,81 @@ void L1Cache::recordInstruction(bool is_write)
     {
         stats.read_count++;
     }
-}
\ No newline at end of file
+}
+void L1Cache::saveState(CheckpointWriter &out) const
+{
+    out.put(tags);
+    out.put(states);
+    out.put(allocated);
+    out.put(prefetched);
+    policy->save(out);
+    if (prefetcher)
+        prefetcher->save(out);
+    out.put(stats);
+
+    out.put(is_blocked);
+    out.put(pending_request);
+    out.put(filled_line);
+    out.put(reserved_line);
+    out.put(retrying);
+    out.put(access_start);
+    out.put(access_kind);
+    out.put(merged_accesses);
+    out.put(waiting_for_prefetch);
+    out.put(late_prefetch);
+    out.put(mshrs);
+    out.put(occupancy_since);
+    out.put(write_buffer);
+    out.put(prefetch_blocks);
+}
+
+void L1Cache::loadState(CheckpointReader &in)
+{
+    size_t lines = static_cast<size_t>(S) * E;
+    in.get(tags, lines);
+    in.get(states, lines);
+    in.get(allocated, lines);
+    in.get(prefetched, lines);
+    for (MESIState state : states)
+    {
+        if (static_cast<int>(state) < 0 || static_cast<int>(state) >= COHERENCE_STATES)
+            in.fail();
+    }
+    policy->load(in);
+    if (prefetcher)
+        prefetcher->load(in);
+    in.get(stats);
+
+    in.get(is_blocked);
+    in.get(pending_request);
+    in.get(filled_line);
+    in.get(reserved_line);
+    in.get(retrying);
+    in.get(access_start);
+    in.get(access_kind);
+    in.get(merged_accesses);
+    in.get(waiting_for_prefetch);
+    in.get(late_prefetch);
+    in.get(mshrs);
+    in.get(occupancy_since);
+    in.get(write_buffer);
+    in.get(prefetch_blocks);
+
+    // Line indices and queue lengths the cache relies on without checking
+    int line_count = static_cast<int>(lines);
+    if (filled_line < -1 || filled_line >= line_count || reserved_line < -1 || reserved_line >= line_count ||
+        static_cast<int>(mshrs.size()) > mshr_count ||
+        static_cast<int>(write_buffer.size()) > write_buffer_depth ||
+        prefetch_blocks.size() > static_cast<size_t>(MAX_PREFETCHES))
+        in.fail();
+
+    // Access kinds index the latency histograms
+    auto valid_kind = [](AccessKind kind) { return static_cast<int>(kind) < ACCESS_KINDS; };
+    bool kinds_valid = valid_kind(access_kind);
+    for (const MSHR &mshr : mshrs)
+        kinds_valid = kinds_valid && valid_kind(mshr.kind);
+    for (const MergedAccess &merged : merged_accesses)
+        kinds_valid = kinds_valid && valid_kind(merged.kind);
+    if (!kinds_valid)
+        in.fail();
+}
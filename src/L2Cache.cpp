@@ -0,0 +1,103 @@
+#include "../include/L2Cache.h"
+#include "../include/L1Cache.h"
+#include "../include/TagMatch.h"
+
+L2Cache::L2Cache(int s_bits, int assoc, int b_bits, std::unique_ptr<ReplacementPolicy> replacement)
+    : S(1 << s_bits), E(assoc), s(s_bits), b(b_bits), policy(std::move(replacement))
+{
+    tags.assign(S * E, INVALID_TAG);
+    valid.assign(S * E, 0);
+    dirty_bits.assign(S * E, 0);
+}
+
+int L2Cache::findLine(uint32_t address) const
+{
+    int base = L1Cache::setIndexOf(address, s, b) * E;
+    int way = matchTag(&tags[base], E, L1Cache::tagOf(address, s, b));
+    return way < 0 ? -1 : base + way;
+}
+
+bool L2Cache::contains(uint32_t address) const
+{
+    return findLine(address) >= 0;
+}
+
+bool L2Cache::access(uint32_t address, bool &dirty)
+{
+    int line = findLine(address);
+    if (line < 0)
+    {
+        stats.misses++;
+        return false;
+    }
+    stats.hits++;
+    policy->onHit(line / E, line % E);
+    dirty = dirty_bits[line];
+    return true;
+}
+
+void L2Cache::remove(uint32_t address)
+{
+    int line = findLine(address);
+    if (line < 0)
+        return;
+    tags[line] = INVALID_TAG;
+    valid[line] = 0;
+    dirty_bits[line] = 0;
+}
+
+L2Cache::Victim L2Cache::insert(uint32_t address, bool dirty)
+{
+    Victim victim;
+    int line = findLine(address);
+    if (line >= 0)
+    {
+        dirty_bits[line] |= dirty;
+        policy->onHit(line / E, line % E);
+        return victim;
+    }
+
+    // Free way first, else the policy's victim
+    int set_index = L1Cache::setIndexOf(address, s, b);
+    int base = set_index * E;
+    line = -1;
+    for (int w = 0; w < E && line < 0; ++w)
+    {
+        if (!valid[base + w])
+            line = base + w;
+    }
+    if (line < 0)
+    {
+        line = base + policy->victim(set_index);
+        victim.valid = true;
+        victim.address = (tags[line] << (s + b)) | (set_index << b);
+        victim.dirty = dirty_bits[line];
+        stats.evictions++;
+        if (victim.dirty)
+            stats.writebacks++;
+    }
+
+    tags[line] = L1Cache::tagOf(address, s, b);
+    valid[line] = 1;
+    dirty_bits[line] = dirty;
+    policy->onFill(set_index, line - base);
+    return victim;
+}
+
+void L2Cache::saveState(CheckpointWriter &out) const
+{
+    out.put(tags);
+    out.put(valid);
+    out.put(dirty_bits);
+    policy->save(out);
+    out.put(stats);
+}
+
+void L2Cache::loadState(CheckpointReader &in)
+{
+    in.get(tags, tags.size());
+    in.get(valid, valid.size());
+    in.get(dirty_bits, dirty_bits.size());
+    policy->load(in);
+    in.get(stats);
+}
@@ -0,0 +1,30 @@
+#include "../include/LatencyHistogram.h"
+
+void LatencyHistogram::add(int cycles)
+{
+    histogram[cycles]++;
+    samples++;
+    sum += cycles;
+}
+
+double LatencyHistogram::mean() const
+{
+    return samples > 0 ? static_cast<double>(sum) / samples : 0.0;
+}
+
+int LatencyHistogram::percentile(double percent) const
+{
+    long long seen = 0;
+    for (const auto &entry : histogram)
+    {
+        seen += entry.second;
+        if (100.0 * seen >= percent * samples)
+            return entry.first;
+    }
+    return 0;
+}
+
+int LatencyHistogram::max() const
+{
+    return histogram.empty() ? 0 : histogram.rbegin()->first;
+}
@@ -0,0 +1,109 @@
+#include "../include/MissProfiler.h"
+#include "../include/L1Cache.h"
+#include <algorithm>
+
+MissProfiler::MissProfiler(int s_bits, int assoc, int b_bits, int region_bits)
+    : s(s_bits), b(b_bits), region_bits(region_bits),
+      shadow_lines(static_cast<size_t>(assoc) << s_bits), sets(size_t(1) << s_bits)
+{
+}
+
+bool MissProfiler::shadowAccess(uint32_t block)
+{
+    auto it = shadow_index.find(block);
+    if (it != shadow_index.end())
+    {
+        shadow.splice(shadow.begin(), shadow, it->second);
+        return true;
+    }
+    shadow.push_front(block);
+    shadow_index[block] = shadow.begin();
+    if (shadow.size() > shadow_lines)
+    {
+        shadow_index.erase(shadow.back());
+        shadow.pop_back();
+    }
+    return false;
+}
+
+void MissProfiler::access(uint32_t address, bool hit)
+{
+    uint32_t block = address >> b;
+    MissCounts &set = sets[L1Cache::setIndexOf(address, s, b)];
+    MissCounts &region = regions[address >> region_bits];
+    set.accesses++;
+    region.accesses++;
+    total.accesses++;
+
+    bool shadow_hit = shadowAccess(block);
+    bool first = seen.insert(block).second;
+    bool lost_to_snoop = invalidated.erase(block) > 0;
+    if (hit)
+        return;
+
+    long long MissCounts::*cause = &MissCounts::conflict;
+    if (first)
+        cause = &MissCounts::compulsory;
+    else if (lost_to_snoop)
+        cause = &MissCounts::coherence;
+    else if (!shadow_hit)
+        cause = &MissCounts::capacity;
+    for (MissCounts *counts : {&set, &region, &total})
+    {
+        counts->misses++;
+        counts->*cause += 1;
+    }
+}
+
+void MissProfiler::eviction(int set, std::optional<uint32_t> victim_address)
+{
+    sets[set].evictions++;
+    if (victim_address)
+        regions[*victim_address >> region_bits].evictions++;
+    total.evictions++;
+}
+
+void MissProfiler::invalidation(uint32_t address)
+{
+    invalidated.insert(address >> b);
+}
+
+std::vector<int> MissProfiler::hottestSets(int count) const
+{
+    std::vector<int> order(sets.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = static_cast<int>(i);
+    count = std::min(count, static_cast<int>(order.size()));
+    std::partial_sort(order.begin(), order.begin() + count, order.end(), [&](int x, int y)
+                      {
+                          if (sets[x].misses != sets[y].misses)
+                              return sets[x].misses > sets[y].misses;
+                          return x < y;
+                      });
+    order.resize(count);
+    return order;
+}
+
+void MissProfiler::writeCsvHeader(std::ostream &out, const char *key)
+{
+    out << "core," << key << ",accesses,misses,evictions,compulsory,capacity,conflict,coherence\n";
+}
+
+void MissProfiler::writeRow(std::ostream &out, int core_id, uint32_t key, const MissCounts &counts)
+{
+    out << core_id << "," << key << "," << counts.accesses << "," << counts.misses << ","
+        << counts.evictions << "," << counts.compulsory << "," << counts.capacity << ","
+        << counts.conflict << "," << counts.coherence << "\n";
+}
+
+void MissProfiler::writeSetRows(std::ostream &out, int core_id) const
+{
+    for (size_t i = 0; i < sets.size(); ++i)
+        writeRow(out, core_id, static_cast<uint32_t>(i), sets[i]);
+}
+
+void MissProfiler::writeRegionRows(std::ostream &out, int core_id) const
+{
+    for (const auto &entry : regions)
+        writeRow(out, core_id, entry.first << region_bits, entry.second);
+}
@@ -0,0 +1,174 @@
+#include "../include/Prefetcher.h"
+#include "../include/Checkpoint.h"
+#include <algorithm>
+
+const char *const PREFETCHER_NAMES = "next-line, stride, stream";
+
+namespace
+{
+    // Tagged next-line: every trigger fetches the following degree blocks
+    class NextLinePrefetcher : public Prefetcher
+    {
+    public:
+        explicit NextLinePrefetcher(int degree) : degree(degree) {}
+
+        const char *name() const override { return "Next-line"; }
+
+        void observe(uint32_t block, bool trigger, std::vector<uint32_t> &candidates) override
+        {
+            if (!trigger)
+                return;
+            for (int k = 1; k <= degree; ++k)
+                candidates.push_back(block + k);
+        }
+
+        void save(CheckpointWriter &out) const override {}
+        void load(CheckpointReader &in) override {}
+
+    private:
+        int degree;
+    };
+
+    // Stride detection on the core's block address stream, without PCs: once the
+    // same non-zero stride has repeated twice, fetch degree strides ahead
+    class StridePrefetcher : public Prefetcher
+    {
+    public:
+        explicit StridePrefetcher(int degree) : degree(degree) {}
+
+        const char *name() const override { return "Stride"; }
+
+        void observe(uint32_t block, bool trigger, std::vector<uint32_t> &candidates) override
+        {
+            // Further accesses within the same block carry no stride information
+            if (trained && block == last_block)
+                return;
+
+            int32_t delta = static_cast<int32_t>(block - last_block);
+            if (trained && delta == stride)
+            {
+                confidence = std::min(confidence + 1, 3);
+            }
+            else
+            {
+                stride = delta;
+                confidence = 0;
+            }
+            last_block = block;
+            trained = true;
+
+            if (confidence >= 2)
+            {
+                for (int k = 1; k <= degree; ++k)
+                    candidates.push_back(block + static_cast<uint32_t>(stride * k));
+            }
+        }
+
+        void save(CheckpointWriter &out) const override
+        {
+            out.put(trained);
+            out.put(last_block);
+            out.put(stride);
+            out.put(confidence);
+        }
+
+        void load(CheckpointReader &in) override
+        {
+            in.get(trained);
+            in.get(last_block);
+            in.get(stride);
+            in.get(confidence);
+        }
+
+    private:
+        int degree;
+        bool trained = false;
+        uint32_t last_block = 0;
+        int32_t stride = 0;
+        int confidence = 0;
+    };
+
+    // Stream buffer style detector: tracks up to STREAMS recent miss regions. A
+    // trigger close to a region's last block sets its direction; later triggers
+    // in that direction fetch degree blocks ahead of the stream.
+    class StreamPrefetcher : public Prefetcher
+    {
+    public:
+        explicit StreamPrefetcher(int degree) : degree(degree) {}
+
+        const char *name() const override { return "Stream"; }
+
+        void observe(uint32_t block, bool trigger, std::vector<uint32_t> &candidates) override
+        {
+            if (!trigger)
+                return;
+            ++clock;
+
+            for (auto &stream : streams)
+            {
+                int32_t delta = static_cast<int32_t>(block - stream.last_block);
+                if (stream.last_use == 0 || delta == 0 || delta < -WINDOW || delta > WINDOW)
+                    continue;
+
+                int direction = delta > 0 ? 1 : -1;
+                if (stream.direction == 0)
+                    stream.direction = direction; // Second trigger confirms the stream
+                if (stream.direction == direction)
+                {
+                    for (int k = 1; k <= degree; ++k)
+                        candidates.push_back(block + static_cast<uint32_t>(direction * k));
+                }
+                stream.last_block = block;
+                stream.last_use = clock;
+                return;
+            }
+
+            // New stream in the least recently used slot
+            Stream *slot = &streams[0];
+            for (auto &stream : streams)
+            {
+                if (stream.last_use < slot->last_use)
+                    slot = &stream;
+            }
+            *slot = {block, 0, clock};
+        }
+
+        void save(CheckpointWriter &out) const override
+        {
+            for (const Stream &stream : streams)
+                out.put(stream);
+            out.put(clock);
+        }
+
+        void load(CheckpointReader &in) override
+        {
+            for (Stream &stream : streams)
+                in.get(stream);
+            in.get(clock);
+        }
+
+    private:
+        static constexpr int STREAMS = 8;
+        static constexpr int WINDOW = 4; // Blocks between triggers of one stream
+        struct Stream
+        {
+            uint32_t last_block;
+            int direction;     // +1, -1, or 0 until confirmed
+            uint64_t last_use; // 0 while the slot is empty
+        };
+        int degree;
+        Stream streams[STREAMS] = {};
+        uint64_t clock = 0;
+    };
+}
+
+std::unique_ptr<Prefetcher> makePrefetcher(const std::string &name, int degree)
+{
+    if (name == "next-line")
+        return std::make_unique<NextLinePrefetcher>(degree);
+    if (name == "stride")
+        return std::make_unique<StridePrefetcher>(degree);
+    if (name == "stream")
+        return std::make_unique<StreamPrefetcher>(degree);
+    return nullptr;
+}
@@ -0,0 +1,222 @@
+#include "../include/ReplacementPolicy.h"
+#include "../include/Checkpoint.h"
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <vector>
+
+const char *const REPLACEMENT_POLICY_NAMES = "lru, plru, srrip, brrip, fifo, random";
+
+namespace
+{
+    // Generators go through their text form, the only portable view of their state
+    void saveRng(CheckpointWriter &out, const std::minstd_rand &rng)
+    {
+        std::ostringstream text;
+        text << rng;
+        out.put(text.str());
+    }
+
+    void loadRng(CheckpointReader &in, std::minstd_rand &rng)
+    {
+        std::string text;
+        in.get(text);
+        std::istringstream(text) >> rng;
+    }
+
+    // Evicts the least recently used way, tracked with a per-line timestamp
+    class LruPolicy : public ReplacementPolicy
+    {
+    public:
+        LruPolicy(int sets, int ways) : E(ways), stamp(static_cast<size_t>(sets) * ways, 0) {}
+
+        const char *name() const override { return "LRU"; }
+        void onHit(int set, int way) override { stamp[set * E + way] = ++clock; }
+        void onFill(int set, int way) override { stamp[set * E + way] = ++clock; }
+
+        int victim(int set) override
+        {
+            int base = set * E;
+            int way = 0;
+            for (int w = 1; w < E; ++w)
+            {
+                if (stamp[base + w] < stamp[base + way])
+                    way = w;
+            }
+            return way;
+        }
+
+        void save(CheckpointWriter &out) const override
+        {
+            out.put(stamp);
+            out.put(clock);
+        }
+
+        void load(CheckpointReader &in) override
+        {
+            in.get(stamp, stamp.size());
+            in.get(clock);
+        }
+
+    protected:
+        int E;
+        std::vector<uint64_t> stamp;
+        uint64_t clock = 0;
+    };
+
+    // Evicts the oldest fill; hits do not count as uses
+    class FifoPolicy : public LruPolicy
+    {
+    public:
+        using LruPolicy::LruPolicy;
+
+        const char *name() const override { return "FIFO"; }
+        void onHit(int set, int way) override {}
+    };
+
+    // Binary tree of E - 1 direction bits per set, each pointing at the half to
+    // evict from next. Associativities that are not a power of two use the tree
+    // of the next power of two and never descend into the missing leaves.
+    class TreePlruPolicy : public ReplacementPolicy
+    {
+    public:
+        TreePlruPolicy(int sets, int ways) : E(ways)
+        {
+            while (leaves < E)
+                leaves <<= 1;
+            bits.assign(static_cast<size_t>(sets) * leaves, 0);
+        }
+
+        const char *name() const override { return "Tree-PLRU"; }
+        void onHit(int set, int way) override { point(set, way); }
+        void onFill(int set, int way) override { point(set, way); }
+
+        int victim(int set) override
+        {
+            uint8_t *tree = &bits[static_cast<size_t>(set) * leaves];
+            int node = 1, lo = 0, span = leaves;
+            while (node < leaves)
+            {
+                span >>= 1;
+                // Only go right if that half has real ways
+                bool right = tree[node] && lo + span < E;
+                if (right)
+                    lo += span;
+                node = 2 * node + (right ? 1 : 0);
+            }
+            return lo;
+        }
+
+        void save(CheckpointWriter &out) const override { out.put(bits); }
+        void load(CheckpointReader &in) override { in.get(bits, bits.size()); }
+
+    private:
+        int E;
+        int leaves = 1;
+        std::vector<uint8_t> bits; // Node n of a set's tree at index n (1-based heap order)
+
+        // Point every node on the way's path at the other half
+        void point(int set, int way)
+        {
+            uint8_t *tree = &bits[static_cast<size_t>(set) * leaves];
+            int node = 1, lo = 0, span = leaves;
+            while (node < leaves)
+            {
+                span >>= 1;
+                bool right = way >= lo + span;
+                tree[node] = right ? 0 : 1;
+                if (right)
+                    lo += span;
+                node = 2 * node + (right ? 1 : 0);
+            }
+        }
+    };
+
+    // Re-Reference Interval Prediction with 2-bit re-reference values (RRPV).
+    // Hits predict a near re-reference (0); the victim is the first way predicted
+    // distant (3), ageing the set until one is. SRRIP inserts at 2. BRRIP inserts
+    // at 3 and only 1 fill in 32 at 2, which keeps scans from flushing the set.
+    class RripPolicy : public ReplacementPolicy
+    {
+    public:
+        RripPolicy(int sets, int ways, bool bimodal)
+            : E(ways), bimodal(bimodal), rrpv(static_cast<size_t>(sets) * ways, MAX_RRPV) {}
+
+        const char *name() const override { return bimodal ? "BRRIP" : "SRRIP"; }
+        void onHit(int set, int way) override { rrpv[set * E + way] = 0; }
+
+        void onFill(int set, int way) override
+        {
+            bool long_interval = !bimodal || rng() % 32 == 0;
+            rrpv[set * E + way] = long_interval ? MAX_RRPV - 1 : MAX_RRPV;
+        }
+
+        int victim(int set) override
+        {
+            uint8_t *values = &rrpv[static_cast<size_t>(set) * E];
+            while (true)
+            {
+                for (int w = 0; w < E; ++w)
+                {
+                    if (values[w] == MAX_RRPV)
+                        return w;
+                }
+                for (int w = 0; w < E; ++w)
+                    values[w]++;
+            }
+        }
+
+        void save(CheckpointWriter &out) const override
+        {
+            out.put(rrpv);
+            saveRng(out, rng);
+        }
+
+        void load(CheckpointReader &in) override
+        {
+            in.get(rrpv, rrpv.size());
+            loadRng(in, rng);
+        }
+
+    private:
+        static constexpr uint8_t MAX_RRPV = 3;
+        int E;
+        bool bimodal;
+        std::vector<uint8_t> rrpv;
+        std::minstd_rand rng; // Default seed, so runs are reproducible
+    };
+
+    class RandomPolicy : public ReplacementPolicy
+    {
+    public:
+        explicit RandomPolicy(int ways) : E(ways) {}
+
+        const char *name() const override { return "Random"; }
+        void onHit(int set, int way) override {}
+        void onFill(int set, int way) override {}
+        int victim(int set) override { return static_cast<int>(rng() % E); }
+        void save(CheckpointWriter &out) const override { saveRng(out, rng); }
+        void load(CheckpointReader &in) override { loadRng(in, rng); }
+
+    private:
+        int E;
+        std::minstd_rand rng; // Default seed, so runs are reproducible
+    };
+}
+
+std::unique_ptr<ReplacementPolicy> makeReplacementPolicy(const std::string &name, int sets, int ways)
+{
+    if (name == "lru")
+        return std::make_unique<LruPolicy>(sets, ways);
+    if (name == "plru")
+        return std::make_unique<TreePlruPolicy>(sets, ways);
+    if (name == "srrip")
+        return std::make_unique<RripPolicy>(sets, ways, false);
+    if (name == "brrip")
+        return std::make_unique<RripPolicy>(sets, ways, true);
+    if (name == "fifo")
+        return std::make_unique<FifoPolicy>(sets, ways);
+    if (name == "random")
+        return std::make_unique<RandomPolicy>(ways);
+    return nullptr;
+}
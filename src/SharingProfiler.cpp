@@ -0,0 +1,144 @@
+#include "../include/SharingProfiler.h"
+#include <algorithm>
+#include <string>
+
+SharingProfiler::SharingProfiler(int cores, int b_bits)
+    : num_cores(cores), b(b_bits)
+{
+    granule_bits = std::min(b, std::max(2, b - 6));
+    granules = 1 << (b - granule_bits);
+}
+
+SharingProfiler::BlockSharing &SharingProfiler::block(uint32_t address)
+{
+    BlockSharing &sharing = blocks[address >> b];
+    if (sharing.cores.empty())
+        sharing.cores.resize(num_cores);
+    return sharing;
+}
+
+void SharingProfiler::access(int core, uint32_t address, bool is_write)
+{
+    uint32_t offset = address & ((uint32_t(1) << b) - 1);
+    uint64_t bit = uint64_t(1) << (offset >> granule_bits);
+    CoreUse &use = block(address).cores[core];
+    if (is_write)
+        use.write_mask |= bit;
+    else
+        use.read_mask |= bit;
+}
+
+void SharingProfiler::invalidation(uint32_t address)
+{
+    block(address).invalidations++;
+}
+
+bool SharingProfiler::isContended(const BlockSharing &sharing)
+{
+    if (sharing.invalidations == 0)
+        return false;
+    int users = 0;
+    bool written = false;
+    for (const CoreUse &use : sharing.cores)
+    {
+        if (use.read_mask | use.write_mask)
+            users++;
+        written |= use.write_mask != 0;
+    }
+    return users > 1 && written;
+}
+
+bool SharingProfiler::isTrueSharing(const BlockSharing &sharing)
+{
+    for (size_t i = 0; i < sharing.cores.size(); ++i)
+    {
+        for (size_t j = 0; j < sharing.cores.size(); ++j)
+        {
+            const CoreUse &other = sharing.cores[j];
+            if (i != j && (sharing.cores[i].write_mask & (other.read_mask | other.write_mask)))
+                return true;
+        }
+    }
+    return false;
+}
+
+std::vector<SharingProfiler::RankedBlock> SharingProfiler::ranked(int top) const
+{
+    std::vector<RankedBlock> result;
+    for (const auto &entry : blocks)
+    {
+        if (isContended(entry.second))
+            result.emplace_back(entry.first, &entry.second);
+    }
+    // Most invalidations first, then by address so the order is reproducible
+    std::sort(result.begin(), result.end(), [](const RankedBlock &x, const RankedBlock &y)
+              {
+                  if (x.second->invalidations != y.second->invalidations)
+                      return x.second->invalidations > y.second->invalidations;
+                  return x.first < y.first;
+              });
+    if (static_cast<int>(result.size()) > top)
+        result.resize(top);
+    return result;
+}
+
+void SharingProfiler::printReport(std::ostream &out, int top) const
+{
+    long long contended = 0, false_shared = 0, false_invalidations = 0;
+    for (const auto &entry : blocks)
+    {
+        if (!isContended(entry.second))
+            continue;
+        contended++;
+        if (!isTrueSharing(entry.second))
+        {
+            false_shared++;
+            false_invalidations += entry.second.invalidations;
+        }
+    }
+
+    out << "Sharing Report:" << std::endl;
+    out << "Contended Blocks: " << contended << " (" << false_shared << " false sharing, "
+        << contended - false_shared << " true sharing)" << std::endl;
+    out << "Invalidations on False-Shared Blocks: " << false_invalidations << std::endl;
+    out << "Heatmap: one column per " << (1 << granule_bits) << " bytes; r read, w written, b both" << std::endl;
+
+    for (const RankedBlock &entry : ranked(top))
+    {
+        const BlockSharing &sharing = *entry.second;
+        out << "Block 0x" << std::hex << (entry.first << b) << std::dec << ": "
+            << sharing.invalidations << " invalidations, "
+            << (isTrueSharing(sharing) ? "true" : "false") << " sharing" << std::endl;
+        for (int core = 0; core < num_cores; ++core)
+        {
+            const CoreUse &use = sharing.cores[core];
+            if (!(use.read_mask | use.write_mask))
+                continue;
+            std::string row;
+            for (int g = 0; g < granules; ++g)
+            {
+                bool read = use.read_mask >> g & 1;
+                bool written = use.write_mask >> g & 1;
+                row += read ? (written ? 'b' : 'r') : (written ? 'w' : '.');
+            }
+            out << "  Core " << core << ": " << row << std::endl;
+        }
+    }
+}
+
+void SharingProfiler::writeCsvRows(std::ostream &out, int top) const
+{
+    for (const RankedBlock &entry : ranked(top))
+    {
+        const BlockSharing &sharing = *entry.second;
+        int users = 0;
+        for (const CoreUse &use : sharing.cores)
+        {
+            if (use.read_mask | use.write_mask)
+                users++;
+        }
+        out << "Sharing Block,0x" << std::hex << (entry.first << b) << std::dec << ","
+            << sharing.invalidations << "," << users << ","
+            << (isTrueSharing(sharing) ? "true" : "false") << "\n";
+    }
+}
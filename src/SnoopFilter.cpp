@@ -0,0 +1,83 @@
+#include "../include/SnoopFilter.h"
+
+void SnoopFilter::add(int core_id, uint32_t address)
+{
+    if (deferring)
+    {
+        deferred[core_id].emplace_back(address, true);
+        return;
+    }
+    presence[address >> b] |= uint64_t(1) << core_id;
+}
+
+void SnoopFilter::remove(int core_id, uint32_t address)
+{
+    if (deferring)
+    {
+        deferred[core_id].emplace_back(address, false);
+        return;
+    }
+    auto it = presence.find(address >> b);
+    if (it == presence.end())
+        return;
+    it->second &= ~(uint64_t(1) << core_id);
+    if (it->second == 0)
+        presence.erase(it);
+}
+
+void SnoopFilter::deferUpdates(int cores)
+{
+    deferring = true;
+    deferred.resize(cores);
+}
+
+void SnoopFilter::applyDeferred()
+{
+    deferring = false;
+    for (int core = 0; core < static_cast<int>(deferred.size()); ++core)
+    {
+        for (const auto &update : deferred[core])
+        {
+            if (update.second)
+                add(core, update.first);
+            else
+                remove(core, update.first);
+        }
+        deferred[core].clear();
+    }
+}
+
+uint64_t SnoopFilter::sharers(uint32_t address) const
+{
+    auto it = presence.find(address >> b);
+    return it == presence.end() ? 0 : it->second;
+}
+
+void SnoopFilter::saveState(CheckpointWriter &out) const
+{
+    out.put<uint64_t>(presence.size());
+    for (const auto &entry : presence)
+    {
+        out.put(entry.first);
+        out.put(entry.second);
+    }
+    out.put(probes);
+    out.put(probes_filtered);
+}
+
+void SnoopFilter::loadState(CheckpointReader &in)
+{
+    uint64_t count = 0;
+    in.get(count);
+    presence.clear();
+    for (uint64_t i = 0; i < count && in.ok(); ++i)
+    {
+        uint32_t block = 0;
+        uint64_t mask = 0;
+        in.get(block);
+        in.get(mask);
+        presence[block] = mask;
+    }
+    in.get(probes);
+    in.get(probes_filtered);
+}
@@ -0,0 +1,103 @@
+#include "../include/StackDistance.h"
+#include "../include/L1Cache.h"
+#include <cstring>
+#include <iomanip>
+
+StackDistanceProfiler::StackDistanceProfiler(int b_bits, int max_s_bits, int assoc)
+    : b(b_bits), max_s(max_s_bits), max_assoc(assoc)
+{
+    for (int s = 0; s <= max_s; ++s)
+    {
+        int sets = 1 << s;
+        stacks.emplace_back(static_cast<size_t>(sets) * max_assoc, 0);
+        depths.emplace_back(sets, 0);
+        hits_at_depth.emplace_back(max_assoc, 0);
+    }
+}
+
+void StackDistanceProfiler::access(uint32_t address)
+{
+    ++total_accesses;
+    for (int s = 0; s <= max_s; ++s)
+    {
+        int set_index = L1Cache::setIndexOf(address, s, b);
+        uint32_t tag = L1Cache::tagOf(address, s, b);
+        uint32_t *stack = &stacks[s][static_cast<size_t>(set_index) * max_assoc];
+        int &depth = depths[s][set_index];
+
+        int d = 0;
+        while (d < depth && stack[d] != tag)
+            ++d;
+
+        if (d < depth)
+        {
+            hits_at_depth[s][d]++;
+        }
+        else if (depth < max_assoc)
+        {
+            ++depth; // Cold or beyond the tracked depth: push, growing the stack
+        }
+        else
+        {
+            d = max_assoc - 1; // Stack full: the LRU entry falls off
+        }
+
+        // Move (or insert) the tag to the MRU position
+        std::memmove(stack + 1, stack, d * sizeof(uint32_t));
+        stack[0] = tag;
+    }
+}
+
+long long StackDistanceProfiler::misses(int s_bits, int E) const
+{
+    long long hits = 0;
+    for (int d = 0; d < E && d < max_assoc; ++d)
+        hits += hits_at_depth[s_bits][d];
+    return total_accesses - hits;
+}
+
+void StackDistanceProfiler::printCurve(std::ostream &out, int core_id) const
+{
+    std::vector<int> columns;
+    for (int E = 1; E < max_assoc; E *= 2)
+        columns.push_back(E);
+    columns.push_back(max_assoc);
+
+    out << "Core " << core_id << " Miss Ratio Curve (%), " << total_accesses
+        << " accesses, block size " << (1 << b) << " bytes:" << std::endl;
+    out << std::setw(10) << "Sets";
+    for (int E : columns)
+        out << std::setw(9) << ("E=" + std::to_string(E));
+    out << std::endl;
+
+    for (int s = 0; s <= max_s; ++s)
+    {
+        out << std::setw(10) << (1 << s);
+        for (int E : columns)
+        {
+            double rate = total_accesses > 0 ? 100.0 * misses(s, E) / total_accesses : 0.0;
+            out << std::setw(9) << std::fixed << std::setprecision(2) << rate;
+        }
+        out << std::endl;
+    }
+    out << std::endl;
+}
+
+void StackDistanceProfiler::writeCsvHeader(std::ostream &out)
+{
+    out << "core,s,E,accesses,misses,miss_rate\n";
+}
+
+void StackDistanceProfiler::writeCsvRows(std::ostream &out, int core_id) const
+{
+    for (int s = 0; s <= max_s; ++s)
+    {
+        for (int E = 1; E <= max_assoc; ++E)
+        {
+            long long m = misses(s, E);
+            double rate = total_accesses > 0 ? 100.0 * m / total_accesses : 0.0;
+            out << core_id << "," << s << "," << E << "," << total_accesses << "," << m << ","
+                << std::fixed << std::setprecision(4) << rate << "\n";
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#include "../include/Sweep.h"
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+bool runSweep(const std::string &trace_name, int cores, const std::vector<CacheConfig> &configs,
+              int threads, const std::function<void(CacheSimulator &)> &configure,
+              std::ostream &csv, bool report_perf)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    SharedTraces refs;
+    size_t trace_bytes = 0;
+    if (!CacheSimulator::readTraces(trace_name, cores, refs, trace_bytes))
+        return false;
+    double load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Each worker claims the next unclaimed configuration until none are left
+    std::vector<std::string> rows(configs.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&]()
+    {
+        size_t k;
+        while ((k = next.fetch_add(1)) < configs.size())
+        {
+            const CacheConfig &config = configs[k];
+            CacheSimulator sim(config.s, config.E, config.b, cores);
+            configure(sim);
+            sim.attachTraces(trace_name, refs);
+            sim.runSimulation();
+
+            std::ostringstream out;
+            sim.writeCsvRows(out);
+            rows[k] = out.str();
+        }
+    };
+
+    threads = std::max(1, std::min<int>(threads, static_cast<int>(configs.size())));
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (auto &t : pool)
+        t.join();
+
+    CacheSimulator::writeCsvHeader(csv);
+    for (const auto &row : rows)
+        csv << row;
+
+    if (report_perf)
+    {
+        double total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "Sweep: " << configs.size() << " configurations on " << threads << " threads" << std::endl;
+        std::cerr << "Trace Load Time (ms): " << std::fixed << std::setprecision(2) << load_seconds * 1000.0 << std::endl;
+        std::cerr << "Total Time (ms): " << total_seconds * 1000.0 << std::endl;
+    }
+    return true;
+}
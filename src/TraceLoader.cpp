@@ -0,0 +1,383 @@
+#include "../include/TraceLoader.h"
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // Value of a hex digit, or -1 for any other character
+    inline int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    inline bool isBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline uint32_t zigzagEncode(int32_t v)
+    {
+        return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+    }
+
+    inline int32_t zigzagDecode(uint32_t v)
+    {
+        return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1);
+    }
+
+    void putVarint(std::string &out, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<char>(v));
+    }
+
+    void putLE64(std::string &out, uint64_t v)
+    {
+        for (int i = 0; i < 8; ++i)
+            out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+
+    // Read one LEB128 varint; false if it runs past stop
+    inline bool getVarint(const unsigned char *&p, const unsigned char *stop, uint64_t &v)
+    {
+        v = 0;
+        for (int shift = 0; p < stop && shift <= 63; shift += 7)
+        {
+            unsigned char byte = *p++;
+            v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    uint64_t getLE64(const unsigned char *p)
+    {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i)
+            v |= static_cast<uint64_t>(p[i]) << (8 * i);
+        return v;
+    }
+}
+
+const char *parseTextRecords(const char *begin, const char *end, std::vector<MemRef> &refs,
+                             size_t max_records, uint64_t &clock)
+{
+    const char *p = begin;
+    size_t parsed = 0;
+
+    while (p < end && parsed < max_records)
+    {
+        // Skip leading whitespace and blank lines
+        while (p < end && (isBlank(*p) || *p == '\n'))
+            ++p;
+        if (p >= end)
+            break;
+
+        char op = *p++;
+        while (p < end && isBlank(*p))
+            ++p;
+
+        // Parse the address: hex with a 0x prefix, decimal otherwise
+        uint32_t address = 0;
+        bool has_digits = false;
+        if (end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+        {
+            p += 2;
+            int v;
+            while (p < end && (v = hexValue(*p)) >= 0)
+            {
+                address = (address << 4) | static_cast<uint32_t>(v);
+                has_digits = true;
+                ++p;
+            }
+        }
+        else
+        {
+            while (p < end && *p >= '0' && *p <= '9')
+            {
+                address = address * 10 + static_cast<uint32_t>(*p - '0');
+                has_digits = true;
+                ++p;
+            }
+        }
+
+        // Optional compute gap: a plain count, or "@cycle" for an absolute timestamp
+        while (p < end && isBlank(*p))
+            ++p;
+        bool timestamp = p < end && *p == '@';
+        if (timestamp)
+            ++p;
+        uint64_t value = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            if (value < UINT64_MAX / 100)
+                value = value * 10 + static_cast<uint64_t>(*p - '0');
+            ++p;
+        }
+
+        if (has_digits)
+        {
+            // A timestamp becomes the gap since the previous record issued; one
+            // that does not move forward issues straight after it
+            uint64_t gap = value;
+            if (timestamp)
+                gap = value > clock ? value - clock : 0;
+            gap = std::min<uint64_t>(gap, MAX_TRACE_GAP);
+            clock += gap + 1;
+            refs.push_back({op == 'W', address, static_cast<uint32_t>(gap)});
+            ++parsed;
+        }
+
+        // Drop whatever is left of the line (trailing whitespace, comments)
+        while (p < end && *p != '\n')
+            ++p;
+    }
+    return p;
+}
+
+size_t parseTextTrace(const char *begin, const char *end, std::vector<MemRef> &refs)
+{
+    size_t before = refs.size();
+    uint64_t clock = 0;
+    parseTextRecords(begin, end, refs, SIZE_MAX, clock);
+    return refs.size() - before;
+}
+
+bool isBinaryTrace(const char *begin, const char *end)
+{
+    return end - begin >= static_cast<std::ptrdiff_t>(BINARY_TRACE_HEADER_SIZE) &&
+           std::memcmp(begin, BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC)) == 0;
+}
+
+bool parseBinaryHeader(const char *begin, const char *end, uint64_t &count, bool &gaps)
+{
+    if (!isBinaryTrace(begin, end))
+        return false;
+    uint8_t version = static_cast<uint8_t>(begin[4]);
+    if (version != BINARY_TRACE_VERSION && version != BINARY_TRACE_VERSION_GAPS)
+        return false;
+    gaps = version == BINARY_TRACE_VERSION_GAPS;
+    count = getLE64(reinterpret_cast<const unsigned char *>(begin) + 8);
+    return true;
+}
+
+const char *decodeBinaryRecords(const char *begin, const char *end, bool gaps, uint32_t &address,
+                                uint64_t &remaining, std::vector<MemRef> &refs, size_t max_records)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(begin);
+    const unsigned char *stop = reinterpret_cast<const unsigned char *>(end);
+    size_t decoded = 0;
+
+    while (remaining > 0 && decoded < max_records)
+    {
+        const unsigned char *q = p;
+        uint64_t v = 0;
+        uint64_t gap = 0;
+        if (!getVarint(q, stop, v) || (gaps && !getVarint(q, stop, gap)))
+            break; // Record runs past the end of the buffer
+
+        p = q;
+        address += static_cast<uint32_t>(zigzagDecode(static_cast<uint32_t>(v >> 1)));
+        refs.push_back({(v & 1) != 0, address, static_cast<uint32_t>(std::min<uint64_t>(gap, MAX_TRACE_GAP))});
+        --remaining;
+        ++decoded;
+    }
+    return reinterpret_cast<const char *>(p);
+}
+
+bool parseBinaryTrace(const char *begin, const char *end, std::vector<MemRef> &refs)
+{
+    uint64_t count = 0;
+    bool gaps = false;
+    if (!parseBinaryHeader(begin, end, count, gaps))
+        return false;
+
+    // Every record takes at least a byte, so a corrupt count cannot force a huge reservation
+    uint64_t room = static_cast<uint64_t>(end - begin) - BINARY_TRACE_HEADER_SIZE;
+    refs.reserve(refs.size() + std::min(count, room));
+    uint32_t address = 0;
+    decodeBinaryRecords(begin + BINARY_TRACE_HEADER_SIZE, end, gaps, address, count, refs, SIZE_MAX);
+    return count == 0;
+}
+
+void encodeBinaryTrace(const std::vector<MemRef> &refs, std::string &out)
+{
+    // Gap-free traces keep the version 1 layout, so older builds can still read them
+    bool gaps = std::any_of(refs.begin(), refs.end(), [](const MemRef &ref) { return ref.gap != 0; });
+    out.append(BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC));
+    out.push_back(static_cast<char>(gaps ? BINARY_TRACE_VERSION_GAPS : BINARY_TRACE_VERSION));
+    out.append(3, '\0');
+    putLE64(out, refs.size());
+
+    uint32_t prev = 0;
+    for (const MemRef &ref : refs)
+    {
+        uint32_t delta = zigzagEncode(static_cast<int32_t>(ref.address - prev));
+        putVarint(out, (static_cast<uint64_t>(delta) << 1) | (ref.is_write ? 1 : 0));
+        if (gaps)
+            putVarint(out, ref.gap);
+        prev = ref.address;
+    }
+}
+
+bool loadTraceFile(const std::string &filename, std::vector<MemRef> &refs, size_t &bytes_read)
+{
+    bytes_read = 0;
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0)
+    {
+        // Nothing to map, an empty trace is still a valid trace
+        close(fd);
+        return true;
+    }
+
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    const char *data = static_cast<const char *>(mapped);
+    bool ok = true;
+    if (isBinaryTrace(data, data + size))
+    {
+        ok = parseBinaryTrace(data, data + size, refs);
+    }
+    else
+    {
+        // Records are at least 4 bytes ("R 0\n"), typically ~10
+        refs.reserve(refs.size() + size / 8);
+        parseTextTrace(data, data + size, refs);
+    }
+
+    munmap(mapped, size);
+    bytes_read = size;
+    return ok;
+}
+
+TraceReader::~TraceReader()
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+bool TraceReader::open(const std::string &filename, size_t buffer_bytes)
+{
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    buffer.resize(std::max(buffer_bytes, BINARY_TRACE_HEADER_SIZE));
+    head = tail = 0;
+    eof = false;
+    fillBuffer();
+
+    binary = isBinaryTrace(buffer.data() + head, buffer.data() + tail);
+    if (binary)
+    {
+        if (!parseBinaryHeader(buffer.data() + head, buffer.data() + tail, remaining, gaps))
+            return false;
+        head += BINARY_TRACE_HEADER_SIZE;
+        address = 0;
+    }
+    return true;
+}
+
+void TraceReader::fillBuffer()
+{
+    // Slide the unconsumed tail to the front, then top the buffer up
+    if (head > 0)
+    {
+        std::memmove(buffer.data(), buffer.data() + head, tail - head);
+        tail -= head;
+        head = 0;
+    }
+    while (!eof && tail < buffer.size())
+    {
+        ssize_t n = ::read(fd, buffer.data() + tail, buffer.size() - tail);
+        if (n <= 0)
+        {
+            eof = true;
+            break;
+        }
+        tail += static_cast<size_t>(n);
+        bytes_read += static_cast<size_t>(n);
+    }
+}
+
+size_t TraceReader::read(std::vector<MemRef> &refs, size_t max_records)
+{
+    size_t before = refs.size();
+
+    while (refs.size() - before < max_records)
+    {
+        size_t want = max_records - (refs.size() - before);
+        const char *begin = buffer.data() + head;
+        const char *end = buffer.data() + tail;
+        const char *stop;
+
+        if (binary)
+        {
+            if (remaining == 0)
+                break;
+            stop = decodeBinaryRecords(begin, end, gaps, address, remaining, refs, want);
+        }
+        else
+        {
+            // Only hand complete lines to the parser unless the file is exhausted
+            const char *limit = end;
+            if (!eof)
+            {
+                while (limit > begin && limit[-1] != '\n')
+                    --limit;
+                if (limit == begin)
+                    limit = (tail - head == buffer.size()) ? end : begin; // Overlong line
+            }
+            stop = parseTextRecords(begin, limit, refs, want, clock);
+        }
+
+        head = static_cast<size_t>(stop - buffer.data());
+        if (refs.size() - before >= max_records)
+            break;
+        if (binary && stop == begin && tail - head == buffer.size())
+        {
+            failed = true; // No record fits in a full buffer, so the varint is malformed
+            break;
+        }
+        if (eof)
+        {
+            if (binary && remaining > 0)
+                failed = true; // Truncated binary trace
+            break;
+        }
+        fillBuffer();
+    }
+    return refs.size() - before;
+}
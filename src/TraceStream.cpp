@@ -0,0 +1,137 @@
+#include "../include/TraceStream.h"
+#include "../include/TraceLoader.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Background decoder: fills `back` while the core consumes the front chunk
+struct TraceStream::Prefetcher
+{
+    TraceReader reader;
+    size_t chunk_records = 0;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<MemRef> back;
+    bool back_ready = false; // back holds a decoded chunk (empty at end of trace)
+    bool stop = false;
+
+    void run()
+    {
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this]
+                        { return !back_ready || stop; });
+                if (stop)
+                    return;
+            }
+
+            back.clear();
+            size_t n = reader.read(back, chunk_records);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                back_ready = true;
+            }
+            cv.notify_all();
+            if (n == 0)
+                return;
+        }
+    }
+
+    ~Prefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+};
+
+TraceStream::TraceStream() = default;
+TraceStream::~TraceStream() = default;
+TraceStream::TraceStream(TraceStream &&) noexcept = default;
+TraceStream &TraceStream::operator=(TraceStream &&) noexcept = default;
+
+void TraceStream::attach(std::shared_ptr<const std::vector<MemRef>> refs)
+{
+    prefetcher.reset();
+    loaded = std::move(refs);
+    begin = cur = loaded->data();
+    end = begin + loaded->size();
+    consumed_before = 0;
+}
+
+bool TraceStream::openStreaming(const std::string &filename, size_t chunk_records)
+{
+    loaded.reset();
+    prefetcher = std::make_unique<Prefetcher>();
+    if (!prefetcher->reader.open(filename))
+    {
+        prefetcher.reset();
+        return false;
+    }
+
+    prefetcher->chunk_records = chunk_records > 0 ? chunk_records : 1;
+    front.reserve(prefetcher->chunk_records);
+    prefetcher->back.reserve(prefetcher->chunk_records);
+    begin = cur = end = nullptr;
+    consumed_before = 0;
+
+    Prefetcher *p = prefetcher.get();
+    p->worker = std::thread([p]
+                            { p->run(); });
+    return true;
+}
+
+bool TraceStream::nextChunk()
+{
+    if (!prefetcher)
+        return false;
+
+    Prefetcher &p = *prefetcher;
+    std::unique_lock<std::mutex> lock(p.mutex);
+    p.cv.wait(lock, [&p]
+              { return p.back_ready; });
+    if (p.back.empty())
+        return false; // End of trace, leave the worker parked
+
+    consumed_before += static_cast<size_t>(end - begin);
+    front.swap(p.back);
+    p.back_ready = false;
+    lock.unlock();
+    p.cv.notify_all();
+
+    begin = cur = front.data();
+    end = begin + front.size();
+    return true;
+}
+
+size_t TraceStream::position() const
+{
+    return consumed_before + static_cast<size_t>(cur - begin);
+}
+
+bool TraceStream::seek(size_t records)
+{
+    while (position() < records)
+    {
+        if (atEnd())
+            return false;
+        // Skip whole chunks at a time rather than record by record
+        cur += std::min(static_cast<size_t>(end - cur), records - position());
+    }
+    return true;
+}
+
+bool TraceStream::hasFailed() const
+{
+    return prefetcher && prefetcher->reader.hasFailed();
+}
@@ -4,24 +4,126 @@
 #include <string>
 #include <filesystem>
 #include <iomanip>
+#include <sstream>
+#include <thread>
+#include <vector>
 #include "../include/CacheSimulator.h"
-
-// Define the DEBUG_MODE variable that other files will reference
-bool DEBUG_MODE = false;
+#include "../include/Sweep.h"
+#include "../include/StackDistance.h"
+#include "../include/ReplacementPolicy.h"
+#include "../include/Prefetcher.h"
+#include "../include/CoherenceProtocol.h"
 
 void printUsage(const std::string &prog)
 {
-    std::cout << "Usage: " << prog << " [-t <tracefile>] [-s <s>] [-E <E>] [-b <b>] [-o <outfilename>] [-h]\n";
+    std::cout << "Usage: " << prog << " [-t <tracefile>] [-s <s>] [-E <E>] [-b <b>] [-r <policy>] [-p <protocol>] [-o <outfilename>] [-n <cores>] [-j <threads>] [--debug] [--no-skip] [--split-bus <N>] [--mshrs <N>] [--write-buffer <N>] [--prefetch <type>] [--prefetch-degree <N>] [--l2 <s,E,b>] [--l2-latency <N>] [--l2-policy <policy>] [--inclusion <mode>] [--stream <records>] [--track-data] [--snoop-filter] [--sharing <N>] [--miss-profile <bits>] [--latency] [--functional] [--sample <P[,U[,W]]>] [--parallel <threads>] [--verify-parallel] [--checkpoint <file> (--checkpoint-at <cycle> | --checkpoint-refs <N>)] [--restore <file>] [--mrc <max_E>] [--perf] [-h]\n";
     std::cout << "Defaults: -t sample, -s 6, -E 2, -b 5\n";
+    std::cout << "  -s/-E/-b take comma-separated lists (e.g. -E 1,2,4,8) to sweep every combination\n";
+    std::cout << "  -j <threads>: simulations run in parallel during a sweep (default: hardware threads)\n";
+    std::cout << "  -r <policy>: replacement policy, one of " << REPLACEMENT_POLICY_NAMES << " (default: lru)\n";
+    std::cout << "  -p <protocol>: coherence protocol, one of " << PROTOCOL_NAMES << " (default: mesi)\n";
     std::cout << "  -h: prints this help\n";
     std::cout << "  -o <outfilename>: logs output in file for plotting etc.\n";
+    std::cout << "  -n <cores>: number of cores (default: number of <tracefile>_procN.trace files found)\n";
+    std::cout << "  --debug: print cycle-by-cycle logs and bus-queue dumps\n";
+    std::cout << "  --no-skip: step every cycle instead of jumping over cycles where all cores are stalled\n";
+    std::cout << "  --split-bus <N>: split-transaction bus with up to N memory transactions in flight\n";
+    std::cout << "  --mshrs <N>: non-blocking caches with N MSHRs each (hit-under-miss, miss-under-miss)\n";
+    std::cout << "  --write-buffer <N>: park up to N dirty victims per core and write them back while the bus is idle\n";
+    std::cout << "  --prefetch <type>: per-core prefetcher, one of " << PREFETCHER_NAMES << "\n";
+    std::cout << "  --prefetch-degree <N>: blocks fetched ahead per prefetch trigger (default: 1)\n";
+    std::cout << "  --l2 <s,E,b>: shared L2 cache between the bus and memory, with b at least the L1 block bits\n";
+    std::cout << "  --l2-latency <N>: cycles for an L2 hit (default: 20)\n";
+    std::cout << "  --l2-policy <policy>: L2 replacement policy (default: lru)\n";
+    std::cout << "  --inclusion <mode>: inclusive, exclusive (same block size as the L1) or nine (default: inclusive)\n";
+    std::cout << "  --stream <records>: stream traces through chunks of <records> instead of loading them\n";
+    std::cout << "  --track-data: allocate a data payload for every cache line\n";
+    std::cout << "  --snoop-filter: track block presence so bus snoops only probe caches holding the block\n";
+    std::cout << "  --sharing <N>: report the N blocks most invalidated between cores, as false or true sharing\n";
+    std::cout << "  --miss-profile <bits>: per-set and per-2^bits-byte-region miss counters and 3C + coherence\n";
+    std::cout << "                         miss classes; with -o, also writes <out>_sets.csv and <out>_regions.csv\n";
+    std::cout << "  --latency: per-core queue wait and service percentiles by bus operation, and end-to-end\n";
+    std::cout << "             percentiles of read misses, write misses and upgrades;\n";
+    std::cout << "             with -o, also writes the histograms to <out>_latency.csv\n";
+    std::cout << "  --functional: no timing; cores take turns completing one reference each, with coherence\n";
+    std::cout << "                applied at once, for fast miss-rate and traffic counts\n";
+    std::cout << "  --sample <P[,U[,W]]>: sampled simulation; of every P references, W (default 2000) run in detail\n";
+    std::cout << "                        to warm up, U (default 1000) are measured and the rest only warm the caches;\n";
+    std::cout << "                        reports estimates with 95% confidence intervals\n";
+    std::cout << "  --parallel <threads>: run the cores on up to <threads> threads between bus events\n";
+    std::cout << "  --verify-parallel: also run the serial engine and check that the results are identical\n";
+    std::cout << "  --checkpoint <file>: save the full simulator state to <file> at --checkpoint-at <cycle> or once\n";
+    std::cout << "                       --checkpoint-refs <N> references have completed; the run then continues\n";
+    std::cout << "  --restore <file>: resume from a checkpoint taken with the same trace and configuration\n";
+    std::cout << "  --mrc <max_E>: single-pass LRU stack-distance miss ratio curves per core, for 2^0..2^s sets\n";
+    std::cout << "                 and E = 1..max_E at block bits b (no timing or coherence)\n";
+    std::cout << "  --perf: report host performance (trace load and simulation throughput, peak RSS)\n";
+}
+
+// Everything printResults reports, as text
+std::string resultsText(CacheSimulator &sim)
+{
+    std::ostringstream text;
+    std::streambuf *saved = std::cout.rdbuf(text.rdbuf());
+    std::ofstream no_csv;
+    sim.printResults(no_csv);
+    std::cout.rdbuf(saved);
+    return text.str();
+}
+
+// Parse a comma-separated list of integers, e.g. "1,2,4"
+std::vector<int> parseList(const std::string &arg)
+{
+    std::vector<int> values;
+    size_t start = 0;
+    while (start <= arg.size())
+    {
+        size_t comma = arg.find(',', start);
+        if (comma == std::string::npos)
+            comma = arg.size();
+        values.push_back(std::stoi(arg.substr(start, comma - start)));
+        start = comma + 1;
+    }
+    return values;
 }
 
 int main(int argc, char *argv[])
 {
     std::string trace_name = "sample";
-    int s = 6, E = 2, b = 5;
+    std::vector<int> s_values = {6}, E_values = {2}, b_values = {5};
+    bool E_given = false; // --mrc takes its associativities from max_E instead
     std::string outfile_name;
+    int cores = 0;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool debug = false;
+    bool cycle_skipping = true;
+    int split_bus = 0;
+    int mshrs = 0;
+    int write_buffer = 0;
+    bool report_perf = false;
+    size_t stream_chunk = 0;
+    bool track_data = false;
+    bool snoop_filter = false;
+    int sharing_top = 0;
+    int profile_region_bits = 0;
+    bool latency_stats = false;
+    std::vector<int> sampling; // P, U, W; empty for a full detailed run
+    bool functional = false;
+    int parallel = 0;
+    bool verify_parallel = false;
+    std::string checkpoint_file;
+    long long checkpoint_cycle = -1;
+    long long checkpoint_refs = -1;
+    std::string restore_file;
+    int mrc_assoc = 0;
+    std::string replacement = "lru";
+    std::string protocol = "mesi";
+    std::string prefetch;
+    int prefetch_degree = 1;
+    std::vector<int> l2_params; // s, E, b; empty without an L2
+    int l2_latency = 20;
+    std::string l2_policy = "lru";
+    std::string inclusion_name = "inclusive";
 
     for (int i = 1; i < argc; ++i)
     {
@@ -34,13 +136,78 @@ int main(int argc, char *argv[])
         if (arg == "-t" && i + 1 < argc)
             trace_name = argv[++i];
         else if (arg == "-s" && i + 1 < argc)
-            s = std::stoi(argv[++i]);
+            s_values = parseList(argv[++i]);
         else if (arg == "-E" && i + 1 < argc)
-            E = std::stoi(argv[++i]);
+        {
+            E_values = parseList(argv[++i]);
+            E_given = true;
+        }
         else if (arg == "-b" && i + 1 < argc)
-            b = std::stoi(argv[++i]);
+            b_values = parseList(argv[++i]);
+        else if (arg == "-r" && i + 1 < argc)
+            replacement = argv[++i];
+        else if (arg == "-p" && i + 1 < argc)
+            protocol = argv[++i];
         else if (arg == "-o" && i + 1 < argc)
             outfile_name = argv[++i];
+        else if (arg == "-n" && i + 1 < argc)
+            cores = std::stoi(argv[++i]);
+        else if (arg == "-j" && i + 1 < argc)
+            threads = std::stoi(argv[++i]);
+        else if (arg == "--debug")
+            debug = true;
+        else if (arg == "--no-skip")
+            cycle_skipping = false;
+        else if (arg == "--split-bus" && i + 1 < argc)
+            split_bus = std::stoi(argv[++i]);
+        else if (arg == "--mshrs" && i + 1 < argc)
+            mshrs = std::stoi(argv[++i]);
+        else if (arg == "--write-buffer" && i + 1 < argc)
+            write_buffer = std::stoi(argv[++i]);
+        else if (arg == "--prefetch" && i + 1 < argc)
+            prefetch = argv[++i];
+        else if (arg == "--prefetch-degree" && i + 1 < argc)
+            prefetch_degree = std::stoi(argv[++i]);
+        else if (arg == "--l2" && i + 1 < argc)
+            l2_params = parseList(argv[++i]);
+        else if (arg == "--l2-latency" && i + 1 < argc)
+            l2_latency = std::stoi(argv[++i]);
+        else if (arg == "--l2-policy" && i + 1 < argc)
+            l2_policy = argv[++i];
+        else if (arg == "--inclusion" && i + 1 < argc)
+            inclusion_name = argv[++i];
+        else if (arg == "--stream" && i + 1 < argc)
+            stream_chunk = std::stoul(argv[++i]);
+        else if (arg == "--track-data")
+            track_data = true;
+        else if (arg == "--snoop-filter")
+            snoop_filter = true;
+        else if (arg == "--sharing" && i + 1 < argc)
+            sharing_top = std::stoi(argv[++i]);
+        else if (arg == "--miss-profile" && i + 1 < argc)
+            profile_region_bits = std::stoi(argv[++i]);
+        else if (arg == "--latency")
+            latency_stats = true;
+        else if (arg == "--functional")
+            functional = true;
+        else if (arg == "--sample" && i + 1 < argc)
+            sampling = parseList(argv[++i]);
+        else if (arg == "--parallel" && i + 1 < argc)
+            parallel = std::stoi(argv[++i]);
+        else if (arg == "--verify-parallel")
+            verify_parallel = true;
+        else if (arg == "--checkpoint" && i + 1 < argc)
+            checkpoint_file = argv[++i];
+        else if (arg == "--checkpoint-at" && i + 1 < argc)
+            checkpoint_cycle = std::stoll(argv[++i]);
+        else if (arg == "--checkpoint-refs" && i + 1 < argc)
+            checkpoint_refs = std::stoll(argv[++i]);
+        else if (arg == "--restore" && i + 1 < argc)
+            restore_file = argv[++i];
+        else if (arg == "--mrc" && i + 1 < argc)
+            mrc_assoc = std::stoi(argv[++i]);
+        else if (arg == "--perf")
+            report_perf = true;
         else
         {
             std::cerr << "Unknown option " << arg << "\n";
@@ -48,28 +215,337 @@ int main(int argc, char *argv[])
             return 1;
         }
     }
-    if (s <= 0 || E <= 0 || b <= 0)
+    std::vector<CacheConfig> configs;
+    for (int s : s_values)
+        for (int E : E_values)
+            for (int b : b_values)
+            {
+                if (s <= 0 || E <= 0 || b <= 0)
+                {
+                    std::cerr << "Invalid parameters\n";
+                    return 1;
+                }
+                configs.push_back({s, E, b});
+            }
+
+    if (!makeReplacementPolicy(replacement, 1, 1))
+    {
+        std::cerr << "Unknown replacement policy " << replacement << " (" << REPLACEMENT_POLICY_NAMES << ")\n";
+        return 1;
+    }
+
+    if (profile_region_bits < 0 || profile_region_bits > 31)
+    {
+        std::cerr << "Invalid --miss-profile region bits " << profile_region_bits << " (1-31)\n";
+        return 1;
+    }
+
+    if (split_bus < 0)
     {
-        std::cerr << "Invalid parameters\n";
+        std::cerr << "Invalid --split-bus slot count " << split_bus << " (0 for the atomic bus)\n";
         return 1;
     }
 
-    if (DEBUG_MODE)
+    if (mshrs < 0)
+    {
+        std::cerr << "Invalid --mshrs count " << mshrs << " (0 for a blocking cache)\n";
+        return 1;
+    }
+
+    if (write_buffer < 0)
+    {
+        std::cerr << "Invalid --write-buffer depth " << write_buffer << " (0 for no buffer)\n";
+        return 1;
+    }
+
+    if (checkpoint_file.empty() != (checkpoint_cycle < 0 && checkpoint_refs < 0))
+    {
+        std::cerr << "--checkpoint <file> needs --checkpoint-at <cycle> or --checkpoint-refs <N>, and vice versa\n";
+        return 1;
+    }
+
+    if (!sampling.empty())
+    {
+        if (sampling.size() < 2)
+            sampling.push_back(1000);
+        if (sampling.size() < 3)
+            sampling.push_back(2000);
+        if (sampling.size() > 3 || sampling[1] < 1 || sampling[2] < 0 ||
+            static_cast<long long>(sampling[1]) + sampling[2] > sampling[0])
+        {
+            std::cerr << "Invalid --sample P,U,W (U >= 1 measured and W >= 0 warm-up references per period P >= U + W)\n";
+            return 1;
+        }
+        if (sharing_top > 0 || profile_region_bits > 0 || latency_stats || !checkpoint_file.empty() ||
+            !restore_file.empty())
+        {
+            std::cerr << "--sample reports estimates only; it cannot be combined with --sharing, --miss-profile,\n"
+                      << "--latency or checkpoints\n";
+            return 1;
+        }
+    }
+
+    if (functional && (split_bus > 0 || mshrs > 0 || write_buffer > 0 || !prefetch.empty() || latency_stats ||
+                       !sampling.empty() || parallel > 0 || verify_parallel || !checkpoint_file.empty() ||
+                       !restore_file.empty()))
+    {
+        std::cerr << "--functional has no timing; it cannot be combined with --split-bus, --mshrs, --write-buffer,\n"
+                  << "--prefetch, --latency, --sample, --parallel or checkpoints\n";
+        return 1;
+    }
+
+    if (verify_parallel && parallel == 0)
+        parallel = threads;
+    if (parallel < 0)
+    {
+        std::cerr << "Invalid --parallel thread count " << parallel << "\n";
+        return 1;
+    }
+    if (parallel > 0 && (debug || sharing_top > 0 || !sampling.empty() || !checkpoint_file.empty() ||
+                         !restore_file.empty()))
+    {
+        std::cerr << "--parallel cannot be combined with --debug, --sharing, --sample or checkpoints\n";
+        return 1;
+    }
+
+    if (!findProtocol(protocol))
+    {
+        std::cerr << "Unknown coherence protocol " << protocol << " (" << PROTOCOL_NAMES << ")\n";
+        return 1;
+    }
+
+    if (!prefetch.empty() && (!makePrefetcher(prefetch, 1) || prefetch_degree < 1))
+    {
+        std::cerr << "Invalid prefetcher " << prefetch << " (" << PREFETCHER_NAMES << ", degree >= 1)\n";
+        return 1;
+    }
+
+    InclusionPolicy inclusion = InclusionPolicy::INCLUSIVE;
+    if (inclusion_name == "exclusive")
+        inclusion = InclusionPolicy::EXCLUSIVE;
+    else if (inclusion_name == "nine")
+        inclusion = InclusionPolicy::NINE;
+    else if (inclusion_name != "inclusive")
+    {
+        std::cerr << "Unknown inclusion policy " << inclusion_name << " (inclusive, exclusive, nine)\n";
+        return 1;
+    }
+    if (!l2_params.empty())
+    {
+        bool valid = l2_params.size() == 3 && l2_params[0] > 0 && l2_params[1] > 0 && l2_params[2] > 0 &&
+                     l2_latency >= 1 && makeReplacementPolicy(l2_policy, 1, 1);
+        for (const CacheConfig &config : configs)
+        {
+            // L2 blocks hold whole L1 blocks; exclusive swaps need them the same size
+            if (l2_params.size() == 3 && (l2_params[2] < config.b ||
+                                          (inclusion == InclusionPolicy::EXCLUSIVE && l2_params[2] != config.b)))
+                valid = false;
+        }
+        if (!valid)
+        {
+            std::cerr << "Invalid L2 parameters (--l2 s,E,b with b >= L1 b, equal for exclusive; --l2-latency >= 1; "
+                      << "--l2-policy one of " << REPLACEMENT_POLICY_NAMES << ")\n";
+            return 1;
+        }
+    }
+
+    if (cores == 0)
+    {
+        // Discover the core count from the trace files; fall back to 4 so the
+        // missing proc0 trace is reported by loadTraces
+        cores = CacheSimulator::countTraceFiles(trace_name);
+        if (cores == 0)
+            cores = 4;
+    }
+    if (cores < 1 || cores > MAX_CORES)
+    {
+        std::cerr << "Invalid core count " << cores << " (1-" << MAX_CORES << " supported)\n";
+        return 1;
+    }
+
+    if (mrc_assoc > 0)
+    {
+        // Miss ratio curves come from one pass per core instead of one simulation per point
+        if (configs.size() > 1 || E_given)
+        {
+            std::cerr << "--mrc covers every set count up to -s and E up to max_E; give single -s/-b values and no -E\n";
+            return 1;
+        }
+        SharedTraces refs;
+        size_t trace_bytes = 0;
+        if (!CacheSimulator::readTraces(trace_name, cores, refs, trace_bytes))
+            return 1;
+
+        std::ofstream csv;
+        if (!outfile_name.empty())
+        {
+            csv.open(outfile_name);
+            StackDistanceProfiler::writeCsvHeader(csv);
+        }
+        for (int i = 0; i < cores; ++i)
+        {
+            StackDistanceProfiler profiler(configs[0].b, configs[0].s, mrc_assoc);
+            for (const MemRef &ref : *refs[i])
+                profiler.access(ref.address);
+            profiler.printCurve(std::cout, i);
+            if (csv.is_open())
+                profiler.writeCsvRows(csv, i);
+        }
+        return 0;
+    }
+
+    // Options shared by every simulator, single run or sweep
+    auto configure = [&](CacheSimulator &sim)
+    {
+        sim.setDebug(debug);
+        sim.setCycleSkipping(cycle_skipping);
+        sim.setSplitBus(split_bus);
+        sim.setMshrs(mshrs);
+        sim.setWriteBuffer(write_buffer);
+        sim.setReplacementPolicy(replacement);
+        sim.setProtocol(protocol);
+        if (!prefetch.empty())
+            sim.setPrefetcher(prefetch, prefetch_degree);
+        if (!l2_params.empty())
+            sim.enableL2(l2_params[0], l2_params[1], l2_params[2], l2_latency, l2_policy, inclusion);
+        if (track_data)
+            sim.enableDataTracking();
+        if (snoop_filter)
+            sim.enableSnoopFilter();
+        if (sharing_top > 0)
+            sim.enableSharingReport(sharing_top);
+        if (profile_region_bits > 0)
+            sim.enableMissProfile(profile_region_bits);
+        if (latency_stats)
+            sim.enableLatencyStats();
+        if (!sampling.empty())
+            sim.setSampling(sampling[0], sampling[1], sampling[2]);
+        sim.setFunctional(functional);
+        sim.setParallel(parallel);
+    };
+
+    if (configs.size() > 1)
+    {
+        if (stream_chunk > 0)
+        {
+            std::cerr << "--stream cannot be combined with a sweep, which shares loaded traces\n";
+            return 1;
+        }
+        if (profile_region_bits > 0 || latency_stats)
+        {
+            std::cerr << "--miss-profile and --latency report on a single configuration; give single -s/-E/-b values\n";
+            return 1;
+        }
+        if (!checkpoint_file.empty() || !restore_file.empty())
+        {
+            std::cerr << "Checkpoints hold a single configuration; give single -s/-E/-b values\n";
+            return 1;
+        }
+        if (parallel > 0)
+        {
+            std::cerr << "--parallel runs a single configuration; a sweep already runs them in parallel (-j)\n";
+            return 1;
+        }
+        if (debug)
+        {
+            std::cerr << "--debug logs a single configuration; give single -s/-E/-b values\n";
+            return 1;
+        }
+        if (!sampling.empty())
+        {
+            std::cerr << "--sample reports estimates for a single configuration; give single -s/-E/-b values\n";
+            return 1;
+        }
+        if (outfile_name.empty())
+            return runSweep(trace_name, cores, configs, threads, configure, std::cout, report_perf) ? 0 : 1;
+        std::ofstream csv(outfile_name);
+        return runSweep(trace_name, cores, configs, threads, configure, csv, report_perf) ? 0 : 1;
+    }
+
+    const CacheConfig &config = configs.front();
+    if (debug)
     {
         std::cout << "=== Debug Mode Enabled ===" << std::endl;
-        std::cout << "Parameters: s=" << s << ", E=" << E << ", b=" << b << std::endl;
+        std::cout << "Parameters: s=" << config.s << ", E=" << config.E << ", b=" << config.b
+                  << ", cores=" << cores << std::endl;
         std::cout << "Trace: " << trace_name << std::endl;
     }
 
-    CacheSimulator sim(s, E, b);
+    CacheSimulator sim(config.s, config.E, config.b, cores);
+    configure(sim);
+    sim.setStreaming(stream_chunk);
     if (!sim.loadTraces(trace_name))
         return 1;
+    if (!restore_file.empty() && !sim.restoreCheckpoint(restore_file))
+        return 1;
+    if (!checkpoint_file.empty())
+        sim.setCheckpoint(checkpoint_file, checkpoint_cycle, checkpoint_refs);
 
     sim.runSimulation();
 
+    std::string verification; // Outcome of --verify-parallel, reported after the results
+    bool verified = true;
+    if (verify_parallel)
+    {
+        // Same configuration on the serial engine, compared on every reported figure
+        CacheSimulator serial(config.s, config.E, config.b, cores);
+        configure(serial);
+        serial.setParallel(0);
+        serial.setStreaming(stream_chunk);
+        if (!serial.loadTraces(trace_name))
+            return 1;
+        serial.runSimulation();
+
+        std::istringstream expected(resultsText(serial)), actual(resultsText(sim));
+        std::string want, got;
+        int line = 0;
+        bool more_expected, more_actual;
+        do
+        {
+            more_expected = static_cast<bool>(std::getline(expected, want));
+            more_actual = static_cast<bool>(std::getline(actual, got));
+            ++line;
+        } while (more_expected && more_actual && want == got);
+
+        std::ostringstream note;
+        verified = !more_expected && !more_actual;
+        if (verified)
+        {
+            note << "Parallel Verification: identical to the serial engine (serial " << std::fixed
+                 << std::setprecision(2) << serial.simulationSeconds() * 1000.0 << " ms, parallel "
+                 << sim.simulationSeconds() * 1000.0 << " ms)";
+        }
+        else
+        {
+            note << "Error: Parallel results differ from the serial engine at line " << line
+                 << "\n  serial:   " << (more_expected ? want : "(end)")
+                 << "\n  parallel: " << (more_actual ? got : "(end)");
+        }
+        verification = note.str();
+    }
+
     std::ofstream outfile;
     if (!outfile_name.empty())
         outfile.open(outfile_name);
     sim.printResults(outfile);
+    if (!outfile_name.empty())
+    {
+        // Next to the -o file: results.csv gives results_sets.csv, results_latency.csv, ...
+        std::string prefix = std::filesystem::path(outfile_name).replace_extension().string();
+        if (profile_region_bits > 0 && !sim.writeMissProfile(prefix))
+            return 1;
+        if (latency_stats && !sim.writeLatencyHistograms(prefix + "_latency.csv"))
+            return 1;
+    }
+    if (report_perf)
+        sim.printPerformance();
+    if (!verified)
+    {
+        std::cerr << verification << std::endl;
+        return 1;
+    }
+    if (!verification.empty())
+        std::cout << std::endl
+                  << verification << std::endl;
     return 0;
 }
@@ -0,0 +1,79 @@
+#include <cstdio>
+#include <cstdint>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../include/TraceLoader.h"
+
+// Converts text traces to the packed binary format read by L1simulate, or back
+// to text with -d. Either input format is accepted.
+
+void printUsage(const std::string &prog)
+{
+    std::cout << "Usage: " << prog << " [-d] <input.trace> <output.trace>\n";
+    std::cout << "  Converts a trace to the packed binary format (text or binary input)\n";
+    std::cout << "  -d: write the output as text instead\n";
+}
+
+int main(int argc, char *argv[])
+{
+    bool to_text = false;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-h")
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (arg == "-d")
+            to_text = true;
+        else
+            files.push_back(arg);
+    }
+    if (files.size() != 2)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<MemRef> refs;
+    size_t in_bytes = 0;
+    if (!loadTraceFile(files[0], refs, in_bytes))
+    {
+        std::cerr << "Error: Could not load trace file: '" << files[0] << "'" << std::endl;
+        return 1;
+    }
+
+    std::string image;
+    if (to_text)
+    {
+        char line[32];
+        for (const MemRef &ref : refs)
+        {
+            // Gaps are written only where present, so gap-free traces round-trip unchanged
+            int n = ref.gap ? std::snprintf(line, sizeof(line), "%c 0x%x %u\n", ref.is_write ? 'W' : 'R', ref.address,
+                                            ref.gap)
+                            : std::snprintf(line, sizeof(line), "%c 0x%x\n", ref.is_write ? 'W' : 'R', ref.address);
+            image.append(line, n);
+        }
+    }
+    else
+    {
+        encodeBinaryTrace(refs, image);
+    }
+
+    std::ofstream out(files[1], std::ios::binary);
+    if (!out.write(image.data(), image.size()))
+    {
+        std::cerr << "Error: Could not write '" << files[1] << "'" << std::endl;
+        return 1;
+    }
+
+    std::cout << files[0] << " -> " << files[1] << ": " << refs.size() << " records, "
+              << in_bytes << " -> " << image.size() << " bytes" << std::endl;
+    return 0;
+}